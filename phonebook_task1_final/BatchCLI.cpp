@@ -0,0 +1,358 @@
+#include "BatchCLI.h"
+#include "StringPool.h"
+#include <sstream>
+#include <exception>
+
+BatchCLI::BatchCLI(PhoneBook& book, std::ostream& output)
+    : phoneBook(book), out(output), pending(book), keysLoaded(false), fileCommands(true) {}
+
+bool BatchCLI::isCommand(const std::string& word) {
+    return word == "add" || word == "remove" || word == "get" || word == "search" ||
+           word == "count" || word == "stats" || word == "export" || word == "import" ||
+           word == "dump" || word == "batch";
+}
+
+bool BatchCLI::parseContact(const std::string& data, Contact& contact, std::string& error) {
+    Contact parsed;
+    try {
+        if (!parsed.deserialize(data)) {
+            error = "ожидается строка контакта в формате файла";
+            return false;
+        }
+    } catch (const std::exception&) {
+        error = "неверное число телефонов или тип телефона";
+        return false;
+    }
+    
+    // deserialize() не проверяет поля, поэтому контакт собирается заново через сеттеры
+    if (!contact.setFirstName(parsed.getFirstName()) || !contact.setLastName(parsed.getLastName()) ||
+        !contact.setPatronymic(parsed.getPatronymic())) {
+        error = "неверное ФИО";
+        return false;
+    }
+    contact.setAddress(parsed.getAddress());
+    if (!contact.setBirthDate(parsed.getBirthDate())) {
+        error = "неверная дата рождения";
+        return false;
+    }
+    if (!contact.setEmail(parsed.getEmail())) {
+        error = "неверный email";
+        return false;
+    }
+    const auto& phones = parsed.getPhoneNumbers();
+    if (phones.empty()) {
+        error = "нужен хотя бы один телефон";
+        return false;
+    }
+    // Проверяются номера в том виде, в каком они пришли: после упаковки
+    // в PhoneNumber короткий номер выглядит как правильный
+    std::istringstream fields(data);
+    std::string field;
+    for (size_t i = 0; i < 7 + phones.size() && std::getline(fields, field, '|'); ++i) {
+        if (i < 7) {
+            continue;
+        }
+        std::string number = field.substr(0, field.find(','));
+        if (!contact.addPhoneNumber(number, phones[i - 7].type)) {
+            error = "неверный телефон " + number;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BatchCLI::parseId(const std::string& text, ContactId& id) {
+    try {
+        size_t used = 0;
+        unsigned long long key = std::stoull(text, &used);
+        if (used != text.size()) {
+            return false;
+        }
+        id = ContactId::fromKey(key);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool BatchCLI::findContact(const std::string& argument, ContactId& id) {
+    // Ключ содержит разделители полей, id - только цифры
+    if (argument.find('|') == std::string::npos) {
+        return parseId(argument, id);
+    }
+    loadKeys();
+    auto found = keys.find(argument);
+    if (found != keys.end() && !found->second.isValid()) {
+        // Контакт добавлен еще не примененным пакетом: id появится после
+        // применения, поэтому пакет применяется раньше
+        if (!flush()) {
+            return false;
+        }
+        keysLoaded = false;
+        loadKeys();
+        found = keys.find(argument);
+    }
+    if (found == keys.end()) {
+        return false;
+    }
+    id = found->second;
+    return true;
+}
+
+void BatchCLI::respond(size_t line, const std::string& text) {
+    // Пока есть непримененные изменения, ответы копятся, чтобы не нарушить порядок
+    if (!responses.empty()) {
+        Response response = {line, false, text};
+        responses.push_back(response);
+        return;
+    }
+    out << text << '\n';
+}
+
+void BatchCLI::error(size_t line, const std::string& message) {
+    std::ostringstream text;
+    text << "error\t" << line << '\t' << message;
+    respond(line, text.str());
+}
+
+void BatchCLI::queueChange(size_t line) {
+    Response response = {line, true, std::string()};
+    responses.push_back(response);
+}
+
+void BatchCLI::loadKeys() {
+    if (keysLoaded) {
+        return;
+    }
+    keys.clear();
+    ContactsView contacts = phoneBook.view();
+    for (auto it = contacts.begin(); it != contacts.end(); ++it) {
+        keys[PhoneBook::duplicateKey(*it)] = it.id();
+    }
+    keysLoaded = true;
+}
+
+bool BatchCLI::flush() {
+    bool committed = true;
+    if (pending.size() > 0) {
+        committed = pending.commit();
+        if (!committed) {
+            // Справочник не изменился - набор ключей строится заново
+            keysLoaded = false;
+        }
+    }
+    removals.clear();
+    for (const auto& response : responses) {
+        if (!response.pendingChange) {
+            out << response.text << '\n';
+        } else if (committed) {
+            out << "ok" << '\n';
+        } else {
+            out << "error\t" << response.line << "\tпакет изменений не применен" << '\n';
+        }
+    }
+    responses.clear();
+    return committed;
+}
+
+void BatchCLI::search(size_t line, const std::string& argument) {
+    std::string field = "any";
+    std::string query = argument;
+    size_t space = argument.find(' ');
+    if (space != std::string::npos) {
+        std::string first = argument.substr(0, space);
+        if (first == "name" || first == "email" || first == "phone" || first == "any") {
+            field = first;
+            query = argument.substr(space + 1);
+        }
+    }
+    
+    std::vector<size_t> found;
+    if (field == "name") {
+        found = phoneBook.searchByName(query);
+    } else if (field == "email") {
+        found = phoneBook.searchByEmail(query);
+    } else if (field == "phone") {
+        found = phoneBook.searchByPhone(query);
+    } else {
+        found = phoneBook.searchMultiField(query);
+    }
+    
+    ContactSelection selection = phoneBook.select(found);
+    for (auto it = selection.begin(); it != selection.end(); ++it) {
+        out << it.id().toKey() << '\t' << it->serialize() << '\n';
+    }
+    std::ostringstream text;
+    text << "ok\t" << selection.size();
+    respond(line, text.str());
+}
+
+void BatchCLI::dump(size_t line) {
+    // Представление держит снимок: идентификаторы и контакты согласованы,
+    // даже если справочник меняют другие потоки
+    ContactsView contacts = phoneBook.view();
+    
+    // Строки собираются в блоки, чтобы вывод в файл шел крупными записями
+    const size_t BLOCK_SIZE = 64 * 1024;
+    std::string buffer;
+    buffer.reserve(BLOCK_SIZE + 1024);
+    for (auto it = contacts.begin(); it != contacts.end(); ++it) {
+        buffer += std::to_string(it.id().toKey());
+        buffer += '\t';
+        buffer += it->serialize();
+        buffer += '\n';
+        if (buffer.size() >= BLOCK_SIZE) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    std::ostringstream text;
+    text << "ok\t" << contacts.size();
+    respond(line, text.str());
+}
+
+bool BatchCLI::execute(size_t line, const std::string& command, const std::string& argument) {
+    if (command == "add") {
+        Contact contact;
+        std::string message;
+        if (!parseContact(argument, contact, message)) {
+            error(line, message);
+            return false;
+        }
+        loadKeys();
+        if (!keys.insert(std::make_pair(PhoneBook::duplicateKey(contact), ContactId())).second) {
+            error(line, "контакт уже существует");
+            return false;
+        }
+        pending.add(contact);
+        queueChange(line);
+        return true;
+    }
+    if (command == "remove") {
+        ContactId id;
+        size_t index;
+        if (!findContact(argument, id) || !phoneBook.findIndex(id, index) ||
+            !removals.insert(id.toKey()).second) {
+            error(line, "контакт не найден");
+            return false;
+        }
+        loadKeys();
+        ContactHandle contact = phoneBook.getContact(id);
+        if (contact) {
+            keys.erase(PhoneBook::duplicateKey(*contact));
+        }
+        pending.remove(id);
+        queueChange(line);
+        return true;
+    }
+    
+    // Остальные команды читают справочник и видят все предыдущие изменения
+    if (!flush()) {
+        error(line, "команда пропущена: пакет изменений не применен");
+        return false;
+    }
+    
+    if (command == "search") {
+        search(line, argument);
+    } else if (command == "dump") {
+        dump(line);
+    } else if (command == "get") {
+        ContactId id;
+        ContactHandle contact;
+        if (!findContact(argument, id) || !(contact = phoneBook.getContact(id))) {
+            error(line, "контакт не найден");
+            return false;
+        }
+        out << id.toKey() << '\t' << contact->serialize() << '\n';
+        respond(line, "ok\t1");
+    } else if (command == "count") {
+        std::ostringstream text;
+        text << "ok\t" << phoneBook.getContactCount();
+        respond(line, text.str());
+    } else if (command == "stats") {
+        StringPoolStats pool = StringPool::instance().getStats();
+        out << "stat\tcontacts\t" << phoneBook.getContactCount() << '\n'
+            << "stat\ttombstones\t" << phoneBook.getTombstoneCount() << '\n'
+            << "stat\tpooled_strings\t" << pool.uniqueStrings << '\n'
+            << "stat\tpooled_bytes\t" << pool.uniqueBytes << '\n'
+            << "stat\tpool_bytes_saved\t" << pool.bytesSaved << '\n';
+        respond(line, "ok");
+    } else if ((command == "export" || command == "import") && !fileCommands) {
+        error(line, "команда " + command + " отключена");
+        return false;
+    } else if (command == "export") {
+        if (argument.empty() || !phoneBook.exportToFile(argument)) {
+            error(line, "не удалось экспортировать в " + argument);
+            return false;
+        }
+        respond(line, "ok");
+    } else if (command == "import") {
+        if (argument.empty() || !phoneBook.importFromFile(argument)) {
+            error(line, "не удалось импортировать из " + argument);
+            return false;
+        }
+        keysLoaded = false;
+        std::ostringstream text;
+        text << "ok\t" << phoneBook.getContactCount();
+        respond(line, text.str());
+    } else {
+        error(line, "неизвестная команда " + command);
+        return false;
+    }
+    return true;
+}
+
+int BatchCLI::runCommand(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        error(0, "не указана команда");
+        return 1;
+    }
+    if (args[0] == "batch") {
+        return runStream(std::cin);
+    }
+    std::string argument;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (i > 1) {
+            argument += ' ';
+        }
+        argument += args[i];
+    }
+    bool ok = execute(1, args[0], argument);
+    ok = flush() && ok;
+    out.flush();
+    return ok ? 0 : 1;
+}
+
+bool BatchCLI::runLine(size_t line, const std::string& text) {
+    size_t length = text.size();
+    if (length > 0 && text[length - 1] == '\r') {
+        --length;
+    }
+    // Пустые строки и комментарии пропускаются
+    if (length == 0 || text[0] == '#') {
+        return true;
+    }
+    size_t space = text.find(' ');
+    if (space >= length) {
+        return execute(line, text.substr(0, length), std::string());
+    }
+    return execute(line, text.substr(0, space), text.substr(space + 1, length - space - 1));
+}
+
+int BatchCLI::runStream(std::istream& in) {
+    bool ok = true;
+    std::string text;
+    size_t line = 0;
+    while (std::getline(in, text)) {
+        ++line;
+        if (!runLine(line, text)) {
+            ok = false;
+        }
+    }
+    if (!flush()) {
+        ok = false;
+    }
+    out.flush();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#ifndef BATCHCLI_H
+#define BATCHCLI_H
+
+#include "PhoneBook.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+// Неинтерактивный режим для скриптов.
+// Команды (в аргументах или построчно во входном потоке):
+//   add <контакт в формате файла>     search [name|email|phone|any] <запрос>
+//   get <контакт>                     remove <контакт>
+//   count                             stats
+//   export <файл>                     import <файл>
+//   dump
+// Ответ на каждую команду - одна строка "ok[\t...]" или
+// "error\t<номер строки>\t<причина>"; найденные контакты выводятся строками
+// "<id>\t<контакт в формате файла>" перед ответом "ok\t<число>";
+// dump так же выводит весь справочник, без построчного сброса потока.
+// <контакт> в get и remove - числовой id из вывода команд или ключ
+// "фамилия|имя|почта" (PhoneBook::duplicateKey()). id - номер записи в
+// загруженном справочнике и действителен только в пределах одного запуска
+// (одной команды, потока batch или работы сервера); между запусками
+// контакт задается ключом.
+// Во входном потоке add и remove накапливаются и применяются одной
+// транзакцией перед первой читающей командой или в конце потока.
+class BatchCLI {
+private:
+    // Отложенный ответ: готовый текст или результат изменения из транзакции
+    struct Response {
+        size_t line;
+        bool pendingChange;
+        std::string text;
+    };
+    
+    PhoneBook& phoneBook;
+    std::ostream& out;
+    PhoneBookTransaction pending;
+    std::vector<Response> responses;
+    
+    // Ключи контактов справочника с учетом накопленных изменений: дубликат
+    // отклоняется сразу, а не проваливает весь пакет при применении.
+    // Значение - идентификатор контакта; у добавленных текущим пакетом он
+    // еще недействителен
+    std::unordered_map<std::string, ContactId> keys;
+    bool keysLoaded;
+    std::unordered_set<uint64_t> removals;  // идентификаторы, удаляемые в текущем пакете
+    bool fileCommands;  // разрешены ли export и import
+    
+    static bool parseContact(const std::string& data, Contact& contact, std::string& error);
+    static bool parseId(const std::string& text, ContactId& id);
+    bool findContact(const std::string& argument, ContactId& id);
+    
+    bool execute(size_t line, const std::string& command, const std::string& argument);
+    void queueChange(size_t line);
+    void respond(size_t line, const std::string& text);
+    void error(size_t line, const std::string& message);
+    void search(size_t line, const std::string& argument);
+    void dump(size_t line);
+    void loadKeys();
+
+public:
+    BatchCLI(PhoneBook& book, std::ostream& output = std::cout);
+    
+    // Одна команда из аргументов командной строки; возвращает код завершения
+    int runCommand(const std::vector<std::string>& args);
+    // Поток команд, по одной в строке; возвращает код завершения
+    int runStream(std::istream& in);
+    
+    // Одна строка потока команд; изменения копятся до flush() или читающей команды
+    bool runLine(size_t line, const std::string& text);
+    // Применяет накопленные изменения и выводит отложенные ответы
+    bool flush();
+    
+    // export и import обращаются к файлам по любому пути; сервер их отключает
+    void setFileCommandsEnabled(bool enabled) { fileCommands = enabled; }
+    
+    static bool isCommand(const std::string& word);
+};
+
+#endif // BATCHCLI_H
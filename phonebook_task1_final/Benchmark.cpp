@@ -0,0 +1,245 @@
+#include "Benchmark.h"
+#include "Collation.h"
+#include "PhoneBook.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char* const NAMES[] = {
+    "Иванов", "Петров", "Сидоров", "Смирнов", "Кузнецов", "Попов", "Васильев",
+    "Соколов", "Михайлов", "Новиков", "Федоров", "Морозов", "Волков", "Алексеев",
+    "Лебедев", "Семенов", "Егоров", "Павлов", "Козлов", "Степанов", "Николаев",
+    "Орлов", "Андреев", "Макаров", "Никитин", "Захаров", "Зайцев", "Соловьев"
+};
+
+// Ключи в том же виде, что строит PhoneBook: фамилия с номером или
+// дата рождения - 4 байта числа ГГГГММДД, у которых первый байт общий
+std::vector<std::string> makeKeys(size_t count, bool dates) {
+    std::mt19937 random(12345);
+    std::vector<std::string> keys(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (dates) {
+            uint32_t packed = static_cast<uint32_t>((1940 + random() % 70) * 10000 +
+                                                    (1 + random() % 12) * 100 + 1 + random() % 28);
+            keys[i].assign(4, '\0');
+            for (int b = 3; b >= 0; --b) {
+                keys[i][b] = static_cast<char>(packed & 0xFF);
+                packed >>= 8;
+            }
+        } else {
+            const char* name = NAMES[random() % (sizeof(NAMES) / sizeof(NAMES[0]))];
+            keys[i] = makeCollationKey(std::string(name) + std::to_string(random() % 1000));
+        }
+    }
+    return keys;
+}
+
+bool measure(const char* title, size_t count, bool dates, unsigned maxThreads, std::ostream& out) {
+    std::vector<std::string> keys = makeKeys(count, dates);
+    std::vector<const std::string*> pointers(count);
+    for (size_t i = 0; i < count; ++i) {
+        pointers[i] = &keys[i];
+    }
+    
+    std::vector<size_t> expected;
+    double baseSeconds = 0;
+    bool same = true;
+    for (unsigned threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+        std::vector<size_t> order(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = i;
+        }
+        Clock::time_point start = Clock::now();
+        radixSortByKeys(order, pointers, threads);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        
+        if (threads == 1) {
+            expected.swap(order);
+            baseSeconds = seconds;
+        } else if (order != expected) {
+            same = false;
+        }
+        out << title << '\t' << threads << '\t' << seconds * 1000 << '\t'
+            << baseSeconds / seconds << '\n';
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+    return same;
+}
+
+// Одна операция чтения заданного вида; number выбирает контакт
+size_t readOperation(const PhoneBook& book, const std::string& kind, size_t number, size_t count) {
+    if (kind == "get") {
+        ContactHandle contact = book.getContact(book.getId(number % count));
+        return contact ? contact->getFirstName().size() : 0;
+    }
+    if (kind == "search") {
+        return book.searchByEmail("user" + std::to_string(number % 1000) + "@").size();
+    }
+    return book.view().size();
+}
+
+double measureReads(PhoneBook& book, const std::string& kind, unsigned threads, bool withWriter,
+                    size_t count, double seconds) {
+    std::atomic<bool> running(true);
+    std::atomic<size_t> operations(0);
+    std::atomic<size_t> checksum(0);  // результаты чтений, чтобы их не выбросил оптимизатор
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&, t]() {
+            size_t done = 0;
+            size_t sink = 0;
+            for (size_t number = t * 7919; running.load(std::memory_order_relaxed); number += 31) {
+                sink += readOperation(book, kind, number, count);
+                ++done;
+            }
+            operations += done;
+            checksum += sink;
+        }));
+    }
+    if (withWriter) {
+        workers.push_back(std::thread([&]() {
+            for (size_t number = 0; running.load(std::memory_order_relaxed); number += 13) {
+                ContactId id = book.getId(number % count);
+                ContactHandle current = book.getContact(id);
+                if (current) {
+                    Contact changed = *current;
+                    changed.setAddress("ул. Ленина, " + std::to_string(number % 100));
+                    book.updateContact(id, changed);
+                }
+            }
+        }));
+    }
+    
+    Clock::time_point start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running = false;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return operations.load() / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}
+
+int runReadBenchmark(size_t count, unsigned maxThreads, double seconds, std::ostream& out) {
+    const char* const FILE_NAME = "phonebook_bench.tmp";
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    int result = 0;
+    {
+        PhoneBook book(FILE_NAME, false);
+        PhoneBookTransaction fill = book.transaction();
+        for (size_t i = 0; i < count; ++i) {
+            fill.add(Contact(i % 2 ? "Анна" : "Иван", NAMES[i % (sizeof(NAMES) / sizeof(NAMES[0]))],
+                             "user" + std::to_string(i) + "@mail.ru", "+79990000000"));
+        }
+        if (!fill.commit()) {
+            out << "error\tне удалось заполнить справочник" << std::endl;
+            result = 1;
+        } else {
+            out << "operation\tthreads\twriter\tops_per_second\n";
+            for (const char* kind : {"get", "search", "view"}) {
+                for (bool withWriter : {false, true}) {
+                    for (unsigned threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+                        out << kind << '\t' << threads << '\t' << (withWriter ? 1 : 0) << '\t'
+                            << static_cast<uint64_t>(measureReads(book, kind, threads, withWriter, count, seconds))
+                            << std::endl;
+                        if (threads == maxThreads) {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    std::remove(FILE_NAME);
+    return result;
+}
+
+int runAccessorBenchmark(size_t count, size_t rounds, std::ostream& out) {
+    // Строка не длиннее внутреннего буфера копируется без выделения памяти
+    static const size_t INLINE_CAPACITY = std::string().capacity();
+    
+    std::vector<Contact> contacts;
+    contacts.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        Contact contact(i % 2 ? "Анна" : "Иван", NAMES[i % (sizeof(NAMES) / sizeof(NAMES[0]))],
+                        "user" + std::to_string(i) + "@mail.ru", "+79990000000");
+        contact.setPatronymic(i % 2 ? "Сергеевна" : "Петрович");
+        contact.setAddress("г. Санкт-Петербург, ул. Ленина, д. " + std::to_string(i % 100));
+        contacts.push_back(std::move(contact));
+    }
+    
+    size_t allocations = 0;
+    for (const auto& contact : contacts) {
+        for (const std::string* field : {&contact.getFirstName(), &contact.getLastName(),
+                                         &contact.getPatronymic(), &contact.getEmail(),
+                                         &contact.getAddress()}) {
+            allocations += field->length() > INLINE_CAPACITY ? 1 : 0;
+        }
+        allocations += 1;  // копия вектора телефонов
+    }
+    
+    size_t checksum = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (const auto& contact : contacts) {
+            checksum += contact.getFirstName().size() + contact.getLastName().size() +
+                        contact.getPatronymic().size() + contact.getEmail().size() +
+                        contact.getAddress().size() + contact.getPhoneNumbers().size();
+        }
+    }
+    double referenceSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    
+    start = Clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (const auto& contact : contacts) {
+            std::string firstName = contact.getFirstName();
+            std::string lastName = contact.getLastName();
+            std::string patronymic = contact.getPatronymic();
+            std::string email = contact.getEmail();
+            std::string address = contact.getAddress();
+            std::vector<PhoneNumber> phones = contact.getPhoneNumbers();
+            checksum += firstName.size() + lastName.size() + patronymic.size() + email.size() +
+                        address.size() + phones.size();
+        }
+    }
+    double copySeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    
+    double reads = static_cast<double>(std::max<size_t>(count * rounds, 1));
+    out << "access\tns_per_contact\tallocations_per_contact\n"
+        << "reference\t" << referenceSeconds * 1e9 / reads << "\t0\n"
+        << "copy\t" << copySeconds * 1e9 / reads << '\t'
+        << static_cast<double>(allocations) / std::max<size_t>(count, 1) << '\n'
+        << "checksum\t" << checksum << std::endl;
+    return 0;
+}
+
+int runSortBenchmark(size_t count, unsigned maxThreads, std::ostream& out) {
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    out << "keys\tthreads\tms\tspeedup\n";
+    bool same = measure("names", count, false, maxThreads, out);
+    same = measure("dates", count, true, maxThreads, out) && same;
+    if (!same) {
+        out << "error\tпорядок при параллельной сортировке отличается" << std::endl;
+        return 1;
+    }
+    out.flush();
+    return 0;
+}
@@ -0,0 +1,400 @@
+#include "Collation.h"
+#include <algorithm>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Разделитель уровней ключа; меньше любого веса символа
+const unsigned char LEVEL_SEPARATOR = 0x01;
+
+// Первичные веса
+const unsigned char WEIGHT_SPACE = 0x02;
+const unsigned char WEIGHT_HYPHEN = 0x03;
+const unsigned char WEIGHT_DIGIT = 0x10;      // 0x10..0x19
+const unsigned char WEIGHT_LATIN = 0x20;      // 0x20..0x39
+const unsigned char WEIGHT_CYRILLIC = 0x40;   // 0x40..0x81: буква русского алфавита - четный
+                                              // вес, следующий нечетный - буквы других
+                                              // кириллических алфавитов после нее
+const unsigned char WEIGHT_OTHER = 0xF0;      // далее 3 байта кодовой точки
+
+// Вторичные веса (диакритика): буква без знаков меньше любой со знаком
+const unsigned char ACCENT_NONE = 0x02;
+const unsigned char ACCENT_LATIN1 = 0x03;     // 0x03..0x22 по кодовой точке
+const unsigned char ACCENT_LATIN_EXT = 0x23;  // 0x23..0x62 по паре букв
+const unsigned char ACCENT_CYRILLIC = 0x80;   // 0x80..0xFF по кодовой точке
+
+// Третичные веса (регистр)
+const unsigned char CASE_LOWER = 0x02;
+const unsigned char CASE_UPPER = 0x03;
+
+// Базовые буквы Latin-1 Supplement U+00C0..U+00DF (строчные - на 0x20 дальше).
+// '#' - лигатуры и буквы, которые раскладываются на две латинские
+const char LATIN1_BASE[] = "aaaaaa#ceeeeiiiidnooooo?ouuuuy#y";
+
+// Базовые буквы Latin Extended-A U+0100..U+017F
+const char LATIN_EXT_A_BASE[] =
+    "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii##jjkkkllllllllll"
+    "nnnnnnnnnoooooo##rrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+
+// Нестрогое декодирование: неверный байт считается отдельным символом
+unsigned int nextCodePoint(const std::string& str, size_t& pos) {
+    unsigned char lead = static_cast<unsigned char>(str[pos]);
+    size_t length = 1;
+    unsigned int cp = lead;
+    
+    if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        cp = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        cp = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        cp = lead & 0x07;
+    }
+    
+    if (length > 1) {
+        if (pos + length > str.length()) {
+            pos += 1;
+            return lead;
+        }
+        for (size_t k = 1; k < length; ++k) {
+            unsigned char c = static_cast<unsigned char>(str[pos + k]);
+            if ((c & 0xC0) != 0x80) {
+                pos += 1;
+                return lead;
+            }
+            cp = (cp << 6) | (c & 0x3F);
+        }
+    }
+    
+    pos += length;
+    return cp;
+}
+
+// Позиция буквы в русском алфавите (0..32) или -1
+int russianLetterIndex(unsigned int lower) {
+    if (lower == 0x0451) return 6;                            // ё
+    if (lower >= 0x0430 && lower <= 0x0435) return lower - 0x0430;  // а..е
+    if (lower >= 0x0436 && lower <= 0x044F) return lower - 0x0430 + 1;  // ж..я
+    return -1;
+}
+
+// Буквы украинского, белорусского, сербского, казахского и других
+// алфавитов: русская буква, после которой они идут, и нужен ли знак
+// (ѐ, ѓ, ќ, ѝ - та же буква с ударением), или отдельная буква сразу за ней
+struct CyrillicLetter {
+    unsigned int lower;
+    unsigned int base;
+    bool accented;
+};
+
+const CyrillicLetter CYRILLIC_LETTERS[] = {
+    {0x0450, 0x0435, true},  {0x0452, 0x0434, false}, {0x0453, 0x0433, true},
+    {0x0454, 0x0435, false}, {0x0455, 0x0437, false}, {0x0456, 0x0438, false},
+    {0x0457, 0x0438, false}, {0x0458, 0x0439, false}, {0x0459, 0x043B, false},
+    {0x045A, 0x043D, false}, {0x045B, 0x0442, false}, {0x045C, 0x043A, true},
+    {0x045D, 0x0438, true},  {0x045E, 0x0443, false}, {0x045F, 0x0447, false},
+    {0x0491, 0x0433, false}, {0x0493, 0x0433, false}, {0x049B, 0x043A, false},
+    {0x04A3, 0x043D, false}, {0x04AF, 0x0443, false}, {0x04B1, 0x0443, false},
+    {0x04BB, 0x0445, false}, {0x04D9, 0x0430, false}, {0x04E9, 0x043E, false}
+};
+
+// Строчная форма буквы; upper - была ли буква заглавной
+unsigned int foldCase(unsigned int cp, bool& upper) {
+    upper = false;
+    if (cp >= 'A' && cp <= 'Z') {
+        upper = true;
+        return cp + ('a' - 'A');
+    }
+    if (cp < 0x00C0) {
+        return cp;
+    }
+    if (cp <= 0x00DE && cp != 0x00D7) {
+        upper = true;
+        return cp + 0x20;
+    }
+    if (cp == 0x0178) {
+        upper = true;
+        return 0x00FF;
+    }
+    if (cp >= 0x0100 && cp <= 0x017F) {
+        // Пары заглавная/строчная; в 0139..0148 и 0179..017E заглавная нечетная
+        bool oddUpper = (cp >= 0x0139 && cp <= 0x0148) || (cp >= 0x0179 && cp <= 0x017E);
+        bool single = cp == 0x0138 || cp == 0x0149 || cp == 0x017F;
+        if (!single && ((cp & 1) == 0) != oddUpper) {
+            upper = true;
+            return cp + 1;
+        }
+        return cp;
+    }
+    if (cp >= 0x0400 && cp <= 0x040F) {
+        upper = true;
+        return cp + 0x50;
+    }
+    if (cp >= 0x0410 && cp <= 0x042F) {
+        upper = true;
+        return cp + 0x20;
+    }
+    // Остальная кириллица (0460..052F) и Latin Extended Additional - пары,
+    // заглавная четная; в 04C1..04CE наоборот
+    bool pairs = (cp >= 0x0460 && cp <= 0x0481) || (cp >= 0x048A && cp <= 0x04BF) ||
+                 (cp >= 0x04D0 && cp <= 0x052F) || (cp >= 0x1E00 && cp <= 0x1E95) ||
+                 (cp >= 0x1EA0 && cp <= 0x1EFF);
+    if (pairs && (cp & 1) == 0) {
+        upper = true;
+        return cp + 1;
+    }
+    if (cp >= 0x04C1 && cp <= 0x04CE && (cp & 1) == 1) {
+        upper = true;
+        return cp + 1;
+    }
+    if (cp == 0x04C0) {
+        upper = true;
+        return 0x04CF;
+    }
+    return cp;
+}
+
+// Две латинские буквы вместо лигатуры (æ, œ, ĳ) или особой буквы (þ, ß)
+const char* latinExpansion(unsigned int lower) {
+    switch (lower) {
+        case 0x00E6: return "ae";
+        case 0x00FE: return "th";
+        case 0x00DF: return "ss";
+        case 0x0133: return "ij";
+        case 0x0153: return "oe";
+    }
+    return nullptr;
+}
+
+void appendLetter(unsigned char weight, unsigned char accent, bool upper,
+                  std::string& primary, std::string& accents, std::string& cases) {
+    primary += static_cast<char>(weight);
+    accents += static_cast<char>(accent);
+    cases += static_cast<char>(upper ? CASE_UPPER : CASE_LOWER);
+}
+
+void appendWeights(unsigned int cp, std::string& primary, std::string& accents, std::string& cases) {
+    bool upper = false;
+    unsigned int lower = foldCase(cp, upper);
+    
+    if (lower == ' ') {
+        appendLetter(WEIGHT_SPACE, ACCENT_NONE, false, primary, accents, cases);
+        return;
+    }
+    if (lower == '-') {
+        appendLetter(WEIGHT_HYPHEN, ACCENT_NONE, false, primary, accents, cases);
+        return;
+    }
+    if (lower >= '0' && lower <= '9') {
+        appendLetter(static_cast<unsigned char>(WEIGHT_DIGIT + (lower - '0')), ACCENT_NONE, false,
+                     primary, accents, cases);
+        return;
+    }
+    if (lower >= 'a' && lower <= 'z') {
+        appendLetter(static_cast<unsigned char>(WEIGHT_LATIN + (lower - 'a')), ACCENT_NONE, upper,
+                     primary, accents, cases);
+        return;
+    }
+    
+    // Латиница со знаками: вес базовой буквы, знак - на втором уровне
+    char base = 0;
+    unsigned char accent = ACCENT_NONE;
+    if (lower >= 0x00E0 && lower <= 0x00FF && lower != 0x00F7) {
+        base = LATIN1_BASE[lower - 0x00E0];
+        accent = static_cast<unsigned char>(ACCENT_LATIN1 + (lower - 0x00E0));
+    } else if (lower == 0x00DF) {
+        // ß идет после ss; вес знака - свободное место ÷, который не буква
+        base = '#';
+        accent = static_cast<unsigned char>(ACCENT_LATIN1 + (0x00F7 - 0x00E0));
+    } else if (lower >= 0x0100 && lower <= 0x017F) {
+        base = LATIN_EXT_A_BASE[lower - 0x0100];
+        accent = static_cast<unsigned char>(ACCENT_LATIN_EXT + ((lower - 0x0100) >> 1));
+    }
+    // Буква без разложения идет по кодовой точке, как прочие символы
+    const char* expansion = base == '#' ? latinExpansion(lower) : nullptr;
+    if (expansion) {
+        for (const char* letter = expansion; *letter; ++letter) {
+            appendLetter(static_cast<unsigned char>(WEIGHT_LATIN + (*letter - 'a')), accent, upper,
+                         primary, accents, cases);
+        }
+        return;
+    }
+    if (base >= 'a' && base <= 'z') {
+        appendLetter(static_cast<unsigned char>(WEIGHT_LATIN + (base - 'a')), accent, upper,
+                     primary, accents, cases);
+        return;
+    }
+    
+    int index = russianLetterIndex(lower);
+    if (index >= 0) {
+        appendLetter(static_cast<unsigned char>(WEIGHT_CYRILLIC + 2 * index), ACCENT_NONE, upper,
+                     primary, accents, cases);
+        return;
+    }
+    for (const auto& letter : CYRILLIC_LETTERS) {
+        if (letter.lower == lower) {
+            int weight = WEIGHT_CYRILLIC + 2 * russianLetterIndex(letter.base) + (letter.accented ? 0 : 1);
+            accent = static_cast<unsigned char>(ACCENT_CYRILLIC + ((lower - 0x0400) & 0x7F));
+            appendLetter(static_cast<unsigned char>(weight), accent, upper, primary, accents, cases);
+            return;
+        }
+    }
+    
+    primary += static_cast<char>(WEIGHT_OTHER);
+    primary += static_cast<char>((lower >> 16) & 0xFF);
+    primary += static_cast<char>((lower >> 8) & 0xFF);
+    primary += static_cast<char>(lower & 0xFF);
+    accents += static_cast<char>(ACCENT_NONE);
+    cases += static_cast<char>(upper ? CASE_UPPER : CASE_LOWER);
+}
+
+// Байт ключа на глубине depth; 0 - ключ закончился
+inline unsigned int byteAt(const std::string& key, size_t depth) {
+    return depth < key.length() ? static_cast<unsigned char>(key[depth]) + 1 : 0;
+}
+
+// Небольшие группы досортировываем сравнением, начиная с depth
+const size_t SMALL_BUCKET = 32;
+
+// Устойчивое распределение по корзинам байта depth; в starts - начала корзин
+void distribute(size_t* items, size_t* buffer, size_t count, size_t depth,
+                const std::vector<const std::string*>& keys, size_t* starts) {
+    size_t counts[258] = {0};
+    for (size_t i = 0; i < count; ++i) {
+        counts[byteAt(*keys[items[i]], depth) + 1]++;
+    }
+    for (size_t b = 1; b < 258; ++b) {
+        counts[b] += counts[b - 1];
+    }
+    
+    std::copy(counts, counts + 257, starts);
+    for (size_t i = 0; i < count; ++i) {
+        buffer[counts[byteAt(*keys[items[i]], depth)]++] = items[i];
+    }
+    std::copy(buffer, buffer + count, items);
+}
+
+void radixSort(size_t* items, size_t* buffer, size_t count, size_t depth,
+               const std::vector<const std::string*>& keys) {
+    if (count < 2) return;
+    
+    if (count < SMALL_BUCKET) {
+        std::stable_sort(items, items + count, [&keys, depth](size_t a, size_t b) {
+            return keys[a]->compare(std::min(depth, keys[a]->length()), std::string::npos,
+                                    *keys[b], std::min(depth, keys[b]->length()), std::string::npos) < 0;
+        });
+        return;
+    }
+    
+    size_t starts[257];
+    distribute(items, buffer, count, depth, keys, starts);
+    
+    // Корзина 0 (ключ закончился) уже упорядочена; остальные - по следующему байту
+    for (size_t b = 1; b < 257; ++b) {
+        size_t begin = starts[b];
+        size_t end = (b + 1 < 257) ? starts[b + 1] : count;
+        radixSort(items + begin, buffer + begin, end - begin, depth + 1, keys);
+    }
+}
+
+}
+
+std::string makeCollationKey(const std::string& str) {
+    std::string primary;
+    std::string accents;
+    std::string cases;
+    primary.reserve(3 * str.length() + 2);
+    accents.reserve(str.length());
+    cases.reserve(str.length());
+    
+    size_t pos = 0;
+    while (pos < str.length()) {
+        appendWeights(nextCodePoint(str, pos), primary, accents, cases);
+    }
+    
+    primary += static_cast<char>(LEVEL_SEPARATOR);
+    primary += accents;
+    primary += static_cast<char>(LEVEL_SEPARATOR);
+    primary += cases;
+    return primary;
+}
+
+void radixSortByKeys(std::vector<size_t>& order, const std::vector<const std::string*>& keys,
+                     unsigned threadCount) {
+    std::vector<size_t> buffer(order.size());
+    
+    if (threadCount == 0) {
+        threadCount = order.size() >= PARALLEL_SORT_THRESHOLD ? std::thread::hardware_concurrency() : 1;
+    }
+    if (threadCount <= 1 || order.size() < SMALL_BUCKET) {
+        radixSort(order.data(), buffer.data(), order.size(), 0, keys);
+        return;
+    }
+    
+    // Общая очередь диапазонов: большой диапазон взявший его поток
+    // распределяет еще на один байт и возвращает корзины в очередь, пока
+    // они не станут заметно меньше доли одного потока. Так работа делится
+    // и тогда, когда у всех ключей общий префикс (например, год рождения).
+    // Диапазоны не пересекаются, поэтому блокировка нужна только очереди.
+    struct Range {
+        size_t begin;
+        size_t count;
+        size_t depth;
+    };
+    size_t* items = order.data();
+    size_t* temp = buffer.data();
+    const size_t splitLimit = std::max(SMALL_BUCKET, order.size() / (8 * threadCount));
+    
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::vector<Range> queue(1, Range{0, order.size(), 0});
+    size_t active = 0;  // сколько диапазонов сейчас обрабатывается
+    
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        while (true) {
+            queueChanged.wait(lock, [&]() { return !queue.empty() || active == 0; });
+            if (queue.empty()) {
+                // Очередь пуста и новых диапазонов больше не появится
+                return;
+            }
+            Range range = queue.back();
+            queue.pop_back();
+            ++active;
+            lock.unlock();
+            
+            std::vector<Range> parts;
+            if (range.count > splitLimit) {
+                size_t starts[257];
+                distribute(items + range.begin, temp + range.begin, range.count, range.depth, keys, starts);
+                for (size_t b = 1; b < 257; ++b) {
+                    size_t end = (b + 1 < 257) ? starts[b + 1] : range.count;
+                    if (end - starts[b] > 1) {
+                        parts.push_back(Range{range.begin + starts[b], end - starts[b], range.depth + 1});
+                    }
+                }
+            } else {
+                radixSort(items + range.begin, temp + range.begin, range.count, range.depth, keys);
+            }
+            
+            lock.lock();
+            --active;
+            queue.insert(queue.end(), parts.begin(), parts.end());
+            queueChanged.notify_all();
+        }
+    };
+    
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threadCount; ++t) {
+        workers.push_back(std::thread(worker));
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
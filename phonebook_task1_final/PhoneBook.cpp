@@ -3,117 +3,1129 @@
 #include <algorithm>
 #include <iostream>
 #include <set>
+#include <unordered_set>
+#include <iterator>
 
-PhoneBook::PhoneBook(const std::string& file) : fileName(file) {
-    loadFromFile();
+// Поиск подстроки без учета регистра; lowerNeedle уже в нижнем регистре.
+// Сравнивает на месте, не создавая копию строки, в которой ищем.
+static bool containsIgnoreCase(const std::string& haystack, const std::string& lowerNeedle) {
+    auto it = std::search(haystack.begin(), haystack.end(),
+                          lowerNeedle.begin(), lowerNeedle.end(),
+                          [](char a, char b) { return static_cast<char>(::tolower(static_cast<unsigned char>(a))) == b; });
+    return it != haystack.end() || lowerNeedle.empty();
+}
+
+// Число строк в потоке; поток возвращается в начало
+static size_t countLines(std::istream& in) {
+    size_t lines = std::count(std::istreambuf_iterator<char>(in),
+                              std::istreambuf_iterator<char>(), '\n') + 1;
+    in.clear();
+    in.seekg(0);
+    return lines;
+}
+
+// Ключ сортировки контакта по полю. Для имен - заранее вычисленный
+// ключ сопоставления, для даты - 4 байта ГГГГММДД в порядке старшинства.
+static const std::string& sortKey(const Contact& contact, SortField field, std::string& buffer) {
+    switch (field) {
+        case SortField::FIRST_NAME:
+            return contact.getFirstNameKey();
+        case SortField::LAST_NAME:
+            return contact.getLastNameKey();
+        case SortField::EMAIL:
+            return contact.getEmail();
+        case SortField::BIRTH_DATE: {
+            const Date& date = contact.getBirthDate();
+            uint32_t packed = static_cast<uint32_t>(date.year * 10000 + date.month * 100 + date.day);
+            buffer.assign(4, '\0');
+            for (int i = 3; i >= 0; --i) {
+                buffer[i] = static_cast<char>(packed & 0xFF);
+                packed >>= 8;
+            }
+            return buffer;
+        }
+    }
+    return buffer;
+}
+
+// Составной ключ по списку критериев. Ключ каждого поля экранируется
+// (0x00 -> 0x00 0xFF) и завершается 0x00 0x00, поэтому более короткое
+// значение меньше любого его продолжения; для убывающего порядка байты
+// поля инвертируются.
+static std::string makeCompositeKey(const Contact& contact, const SortSpec& spec) {
+    std::string composite;
+    std::string buffer;
+    for (const auto& criterion : spec) {
+        const std::string& key = sortKey(contact, criterion.field, buffer);
+        unsigned char mask = (criterion.order == SortOrder::DESCENDING) ? 0xFF : 0x00;
+        for (char c : key) {
+            composite += static_cast<char>(static_cast<unsigned char>(c) ^ mask);
+            if (c == '\0') {
+                composite += static_cast<char>(0xFF ^ mask);
+            }
+        }
+        composite += static_cast<char>(mask);
+        composite += static_cast<char>(mask);
+    }
+    return composite;
+}
+
+std::string PhoneBook::duplicateKey(const Contact& contact) {
+    std::string key = contact.getLastName();
+    key += '|';
+    key += contact.getFirstName();
+    key += '|';
+    key += contact.getEmail();
+    return key;
+}
+
+// Строка файла, отмечающая удаление контакта в режиме надгробий:
+// префикс и ключ дубликата удаленной записи
+static const std::string TOMBSTONE_PREFIX = "#DEL|";
+
+// Убирает из загруженных контактов записи, отмеченные строками удаления;
+// возвращает число убранных
+static size_t dropDeleted(std::vector<ContactHandle>& loaded, const std::unordered_set<std::string>& deletedKeys) {
+    if (deletedKeys.empty()) {
+        return 0;
+    }
+    size_t before = loaded.size();
+    loaded.erase(std::remove_if(loaded.begin(), loaded.end(),
+        [&deletedKeys](const ContactHandle& contact) { return deletedKeys.count(PhoneBook::duplicateKey(*contact)) != 0; }),
+        loaded.end());
+    return before - loaded.size();
+}
+
+// Разбор строки файла: контакт или отметка об удалении
+static void parseLine(const std::string& line, std::vector<ContactHandle>& loaded,
+                      std::unordered_set<std::string>& deletedKeys) {
+    if (line.compare(0, TOMBSTONE_PREFIX.size(), TOMBSTONE_PREFIX) == 0) {
+        deletedKeys.insert(line.substr(TOMBSTONE_PREFIX.size()));
+    } else if (!line.empty()) {
+        Contact contact;
+        if (contact.deserialize(line)) {
+            loaded.push_back(std::make_shared<const Contact>(std::move(contact)));
+        }
+    }
+}
+
+// Маска полей, которыми различаются две версии контакта
+static uint32_t changedFields(const Contact& before, const Contact& after) {
+    uint32_t mask = 0;
+    if (before.getFirstName() != after.getFirstName()) mask |= ChangeEvent::FIRST_NAME;
+    if (before.getLastName() != after.getLastName()) mask |= ChangeEvent::LAST_NAME;
+    if (before.getPatronymic() != after.getPatronymic()) mask |= ChangeEvent::PATRONYMIC;
+    if (before.getAddress() != after.getAddress()) mask |= ChangeEvent::ADDRESS;
+    const Date& beforeDate = before.getBirthDate();
+    const Date& afterDate = after.getBirthDate();
+    if (beforeDate.day != afterDate.day || beforeDate.month != afterDate.month ||
+        beforeDate.year != afterDate.year) {
+        mask |= ChangeEvent::BIRTH_DATE;
+    }
+    if (before.getEmail() != after.getEmail()) mask |= ChangeEvent::EMAIL;
+    if (before.getPhoneNumbers() != after.getPhoneNumbers()) mask |= ChangeEvent::PHONES;
+    return mask;
+}
+
+// Номер поддерживаемого порядка: поле и направление
+static size_t sortViewIndex(SortField field, SortOrder order) {
+    return 2 * static_cast<size_t>(field) + (order == SortOrder::DESCENDING ? 1 : 0);
+}
+
+// Сравнение двух контактов по одному полю
+static bool lessByField(const Contact& a, const Contact& b, SortField field) {
+    std::string bufferA;
+    std::string bufferB;
+    return sortKey(a, field, bufferA) < sortKey(b, field, bufferB);
+}
+
+PhoneBook::PhoneBook(const std::string& file, bool loadNow)
+    : fileName(file), published(std::make_shared<const PhoneBookSnapshot>()),
+      snapshotsEnabled(false), version(0), deadCount(0), tombstoneMode(false),
+      compactThreshold(0.25), staleRecords(0), compactionRunning(false), partiallyLoaded(false),
+      unsavedChanges(false), savedVersion(0), deferredSaves(false), saveQueued(false), nextSubscription(0), hasListeners(false) {
+    invalidateViews();
+    if (loadNow) {
+        loadFromFile();
+    }
 }
 
 PhoneBook::~PhoneBook() {
-    saveToFile();
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+    setDeferredSaves(false);
+    // Команды только для чтения файл не переписывают
+    if (unsavedChanges) {
+        writeSnapshot(*snapshot());
+    }
 }
 
 bool PhoneBook::loadFromFile() {
+    // Запись, начатая до загрузки, завершается раньше чтения файла
+    std::unique_lock<std::mutex> fileLock(fileMutex);
     std::ifstream file(fileName);
     if (!file.is_open()) {
         // Файл не существует - это нормально для первого запуска
         return true;
     }
     
-    contacts.clear();
+    // Новое поколение собирается целиком и затем заменяет старое,
+    // старое освобождается разом при выходе из функции. Экономятся только
+    // перевыделения вектора (резерв по числу строк, перемещение, обмен);
+    // строки полей по-прежнему выделяются по одной, кроме общих строк пула
+    std::vector<ContactHandle> loaded;
+    std::unordered_set<std::string> deletedKeys;
+    loaded.reserve(countLines(file));
     std::string line;
     
     while (std::getline(file, line)) {
-        if (!line.empty()) {
-            Contact contact;
-            if (contact.deserialize(line)) {
-                contacts.push_back(contact);
+        parseLine(line, loaded, deletedKeys);
+    }
+    
+    file.close();
+    size_t stale = dropDeleted(loaded, deletedKeys);
+    contacts.swap(loaded);
+    
+    invalidateViews();
+    releaseAllIds();
+    tombstones.clear();
+    deadCount = 0;
+    partiallyLoaded = false;
+    ids.reserve(contacts.size());
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        ids.push_back(allocateId(i));
+    }
+    recordChange(ChangeEvent(ChangeEvent::RELOADED));
+    publishSnapshot();
+    fileLock.unlock();
+    markSaved(stale);
+    return true;
+}
+
+bool PhoneBook::loadIncrementally(const std::function<bool(size_t, size_t)>& progress, size_t chunkSize) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        progress(0, 0);
+        return true;
+    }
+    size_t total = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+    
+    {
+        ChangeNotifier notifier(*this);
+        WriteGuard guard(rwLock);
+        contacts.clear();
+        invalidateViews();
+        releaseAllIds();
+        tombstones.clear();
+        deadCount = 0;
+        partiallyLoaded = true;
+        recordChange(ChangeEvent(ChangeEvent::RELOADED));
+        publishSnapshot();
+        markSaved();
+    }
+    
+    // Блокировка берется только на добавление готовой части,
+    // разбор строк идет без нее
+    std::vector<ContactHandle> chunk;
+    std::unordered_set<std::string> deletedKeys;
+    chunk.reserve(chunkSize);
+    size_t bytesRead = 0;
+    std::string line;
+    bool completed = true;
+    while (std::getline(file, line)) {
+        bytesRead += line.size() + 1;
+        parseLine(line, chunk, deletedKeys);
+        if (chunk.size() >= chunkSize) {
+            appendLoaded(chunk);
+            if (!progress(std::min(bytesRead, total), total)) {
+                completed = false;
+                break;
             }
         }
     }
-    
     file.close();
+    if (!completed) {
+        return false;
+    }
+    
+    appendLoaded(chunk);
+    dropDeletedLoaded(deletedKeys);
+    progress(total, total);
     return true;
 }
 
-bool PhoneBook::saveToFile() const {
+void PhoneBook::appendLoaded(std::vector<ContactHandle>& chunk) {
+    if (chunk.empty()) {
+        return;
+    }
+    ChangeNotifier notifier(*this);
+    WriteGuard guard(rwLock);
+    contacts.reserve(contacts.size() + chunk.size());
+    for (auto& contact : chunk) {
+        contacts.push_back(std::move(contact));
+        ids.push_back(allocateId(contacts.size() - 1));
+        insertIntoViews(ids.back());
+        recordChange(ChangeEvent(ChangeEvent::ADDED, ids.back()));
+    }
+    chunk.clear();
+    publishSnapshot();
+}
+
+void PhoneBook::dropDeletedLoaded(const std::unordered_set<std::string>& deletedKeys) {
+    ChangeNotifier notifier(*this);
+    WriteGuard guard(rwLock);
+    partiallyLoaded = false;
+    size_t stale = 0;
+    if (!deletedKeys.empty()) {
+        // Отметки об удалении могут ссылаться на любую из прочитанных частей
+        std::vector<bool> removed(contacts.size(), false);
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            removed[i] = deletedKeys.count(duplicateKey(*contacts[i])) != 0;
+            if (removed[i]) {
+                recordChange(ChangeEvent(ChangeEvent::REMOVED, ids[i]));
+                stale++;
+            }
+        }
+        compactRemoved(removed);
+        purgeRemovedFromViews();
+    }
+    // Новая версия снимка уже не помечена как частичная
+    publishSnapshot();
+    markSaved(stale);
+}
+
+bool PhoneBook::saveToFile(const std::vector<bool>& skipped) const {
+    // Строки из skipped к моменту отложенной записи уже удалены
+    if (queueSave()) {
+        std::lock_guard<std::mutex> fileGuard(fileMutex);
+        unsavedChanges = true;
+        return true;
+    }
+    std::lock_guard<std::mutex> fileGuard(fileMutex);
+    unsavedChanges = true;
+    if (partiallyLoaded) {
+        return false;
+    }
     std::ofstream file(fileName);
     if (!file.is_open()) {
         std::cerr << "Ошибка: не удалось открыть файл для записи: " << fileName << std::endl;
         return false;
     }
     
-    for (const auto& contact : contacts) {
-        file << contact.serialize() << std::endl;
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (!isDead(i) && !(i < skipped.size() && skipped[i])) {
+            file << contacts[i]->serialize() << std::endl;
+        }
     }
     
     file.close();
+    // Пакет после записи публикует следующую версию; более ранние версии,
+    // которые еще пишутся после снятия блокировки, файл не перезапишут
+    savedVersion = version + 1;
+    staleRecords = 0;
+    unsavedChanges = false;
     return true;
 }
 
-bool PhoneBook::addContact(const Contact& contact) {
-    // Проверка на дубликат
-    auto it = std::find(contacts.begin(), contacts.end(), contact);
-    if (it != contacts.end()) {
-        std::cerr << "Контакт уже существует!" << std::endl;
+bool PhoneBook::saveSnapshot(const SnapshotPtr& snapshot) const {
+    if (queueSave()) {
+        std::lock_guard<std::mutex> fileGuard(fileMutex);
+        unsavedChanges = true;
+        return true;
+    }
+    return writeSnapshot(*snapshot);
+}
+
+bool PhoneBook::appendTombstones(const std::vector<size_t>& indices) const {
+    std::lock_guard<std::mutex> fileGuard(fileMutex);
+    // Строки дописываются только к файлу с текущей версией справочника;
+    // иначе вызывающий переписывает файл целиком
+    if (partiallyLoaded || savedVersion != version) {
+        return false;
+    }
+    std::ofstream file(fileName, std::ios::app);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка: не удалось открыть файл для записи: " << fileName << std::endl;
         return false;
     }
     
-    contacts.push_back(contact);
-    return saveToFile();
+    for (size_t index : indices) {
+        file << TOMBSTONE_PREFIX << duplicateKey(*contacts[index]) << '\n';
+    }
+    
+    file.close();
+    // Удаление затем публикует следующую версию
+    savedVersion = version + 1;
+    return true;
+}
+
+bool PhoneBook::queueSave() const {
+    std::lock_guard<std::mutex> saverGuard(saverMutex);
+    if (!deferredSaves) {
+        return false;
+    }
+    saveQueued = true;
+    saveWake.notify_one();
+    return true;
+}
+
+bool PhoneBook::writeSnapshot(const PhoneBookSnapshot& snapshot) const {
+    std::lock_guard<std::mutex> fileGuard(fileMutex);
+    // Более новую версию уже записал другой поток
+    if (snapshot.version < savedVersion) {
+        return true;
+    }
+    unsavedChanges = true;
+    if (snapshot.partial) {
+        return false;
+    }
+    std::ofstream file(fileName);
+    if (!file.is_open()) {
+        std::cerr << "Ошибка: не удалось открыть файл для записи: " << fileName << std::endl;
+        return false;
+    }
+    
+    for (size_t i = 0; i < snapshot.getContactCount(); ++i) {
+        file << snapshot.getContact(i).serialize() << std::endl;
+    }
+    
+    file.close();
+    savedVersion = snapshot.version;
+    staleRecords = 0;
+    unsavedChanges = false;
+    return true;
+}
+
+void PhoneBook::runSaver() {
+    std::unique_lock<std::mutex> saverLock(saverMutex);
+    while (true) {
+        saveWake.wait(saverLock, [this] { return saveQueued || !deferredSaves; });
+        if (!saveQueued) {
+            return;
+        }
+        saveQueued = false;
+        saverLock.unlock();
+        
+        // Под блокировкой только сборка снимка; файл пишется без нее,
+        // а изменения, пришедшие во время записи, запишет следующий проход
+        writeSnapshot(*snapshot());
+        saverLock.lock();
+    }
+}
+
+void PhoneBook::setDeferredSaves(bool enabled) {
+    {
+        std::lock_guard<std::mutex> saverGuard(saverMutex);
+        if (deferredSaves == enabled) {
+            return;
+        }
+        deferredSaves = enabled;
+    }
+    if (enabled) {
+        saver = std::thread(&PhoneBook::runSaver, this);
+    } else {
+        // Поток дописывает накопленные изменения и завершается
+        saveWake.notify_one();
+        saver.join();
+    }
+}
+
+bool PhoneBook::addContact(const Contact& contact) {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr changed;
+    {
+        WriteGuard guard(rwLock);
+        
+        // Проверка на дубликат
+        if (containsLive(contact)) {
+            std::cerr << "Контакт уже существует!" << std::endl;
+            return false;
+        }
+        
+        contacts.push_back(std::make_shared<const Contact>(contact));
+        ids.push_back(allocateId(contacts.size() - 1));
+        insertIntoViews(ids.back());
+        recordChange(ChangeEvent(ChangeEvent::ADDED, ids.back()));
+        publishSnapshot();
+        changed = currentSnapshot();
+    }
+    // Файл пишется из снимка, читатели его не ждут
+    return saveSnapshot(changed);
+}
+
+void PhoneBook::mergeContacts(std::vector<Contact>& newContacts) {
+    contacts.reserve(contacts.size() + newContacts.size());
+    for (auto& contact : newContacts) {
+        if (containsLive(contact)) {
+            std::cerr << "Контакт уже существует!" << std::endl;
+            continue;
+        }
+        contacts.push_back(std::make_shared<const Contact>(std::move(contact)));
+        ids.push_back(allocateId(contacts.size() - 1));
+        insertIntoViews(ids.back());
+        recordChange(ChangeEvent(ChangeEvent::ADDED, ids.back()));
+    }
+}
+
+bool PhoneBook::containsLive(const Contact& contact) const {
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (!isDead(i) && *contacts[i] == contact) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool PhoneBook::removeContact(size_t index) {
-    if (index >= contacts.size()) {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr changed;
+    {
+        WriteGuard guard(rwLock);
+        if (!removeAt(index, changed)) {
+            return false;
+        }
+    }
+    return !changed || saveSnapshot(changed);
+}
+
+bool PhoneBook::removeAt(size_t index, SnapshotPtr& changed) {
+    if (index >= contacts.size() || isDead(index)) {
         return false;
     }
     
+    removeFromViews(ids[index]);
+    releaseId(ids[index]);
+    recordChange(ChangeEvent(ChangeEvent::REMOVED, ids[index]));
+    if (tombstoneMode) {
+        // Запись остается на месте до уплотнения, файл только дописывается
+        bool appended = appendTombstones(std::vector<size_t>(1, index));
+        markDead(index);
+        publishSnapshot();
+        if (!appended) {
+            changed = currentSnapshot();
+        }
+        if (compactionDue()) {
+            scheduleCompaction();
+        }
+        return true;
+    }
     contacts.erase(contacts.begin() + index);
-    return saveToFile();
+    ids.erase(ids.begin() + index);
+    updatePositions(index);
+    publishSnapshot();
+    changed = currentSnapshot();
+    return true;
+}
+
+bool PhoneBook::removeContact(ContactId id) {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr changed;
+    {
+        WriteGuard guard(rwLock);
+        size_t index;
+        if (!locateId(id, index) || !removeAt(index, changed)) {
+            return false;
+        }
+    }
+    return !changed || saveSnapshot(changed);
 }
 
 bool PhoneBook::updateContact(size_t index, const Contact& contact) {
-    if (index >= contacts.size()) {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr changed;
+    {
+        WriteGuard guard(rwLock);
+        if (!updateAt(index, contact)) {
+            return false;
+        }
+        changed = currentSnapshot();
+    }
+    return saveSnapshot(changed);
+}
+
+bool PhoneBook::updateAt(size_t index, const Contact& contact) {
+    if (index >= contacts.size() || isDead(index)) {
+        return false;
+    }
+    
+    removeFromViews(ids[index]);
+    recordChange(ChangeEvent(ChangeEvent::UPDATED, ids[index], changedFields(*contacts[index], contact)));
+    // Снимки и выданные ContactHandle продолжают видеть прежнюю версию
+    contacts[index] = std::make_shared<const Contact>(contact);
+    insertIntoViews(ids[index]);
+    publishSnapshot();
+    return true;
+}
+
+bool PhoneBook::updateContact(ContactId id, const Contact& contact) {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr changed;
+    {
+        WriteGuard guard(rwLock);
+        size_t index;
+        if (!locateId(id, index) || !updateAt(index, contact)) {
+            return false;
+        }
+        changed = currentSnapshot();
+    }
+    return saveSnapshot(changed);
+}
+
+PhoneBookTransaction PhoneBook::transaction() {
+    return PhoneBookTransaction(*this);
+}
+
+void PhoneBookTransaction::add(const Contact& contact) {
+    BatchOperation operation;
+    operation.kind = BatchOperation::ADD;
+    operation.contact = contact;
+    operations.push_back(operation);
+}
+
+void PhoneBookTransaction::update(ContactId id, const Contact& contact) {
+    BatchOperation operation;
+    operation.kind = BatchOperation::UPDATE;
+    operation.id = id;
+    operation.contact = contact;
+    operations.push_back(operation);
+}
+
+void PhoneBookTransaction::remove(ContactId id) {
+    BatchOperation operation;
+    operation.kind = BatchOperation::REMOVE;
+    operation.id = id;
+    operations.push_back(operation);
+}
+
+bool PhoneBookTransaction::commit() {
+    bool applied = book.applyBatch(operations);
+    operations.clear();
+    return applied;
+}
+
+bool PhoneBook::applyBatch(const std::vector<BatchOperation>& operations) {
+    ChangeNotifier notifier(*this);
+    WriteGuard guard(rwLock);
+    
+    // Проверка всего пакета до внесения изменений
+    std::vector<bool> removed(contacts.size(), false);
+    std::unordered_set<std::string> keys;
+    bool hasAdds = false;
+    bool hasUpdates = false;
+    size_t removedCount = 0;
+    for (const auto& operation : operations) {
+        if (operation.kind == BatchOperation::ADD) {
+            hasAdds = true;
+            continue;
+        }
+        size_t index;
+        if (!locateId(operation.id, index) || removed[index]) {
+            return false;
+        }
+        if (operation.kind == BatchOperation::REMOVE) {
+            removed[index] = true;
+            removedCount++;
+        } else {
+            hasUpdates = true;
+        }
+    }
+    
+    // Пакет из одних удалений - как removeMany(): в режиме надгробий
+    // файл только дописывается
+    if (!hasAdds && !hasUpdates) {
+        return removeMarked(removed, removedCount) == removedCount;
+    }
+    
+    // Дубликаты ищем по хеш-множеству вместо прохода по справочнику на каждый контакт
+    if (hasAdds) {
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            if (!removed[i] && !isDead(i)) {
+                keys.insert(duplicateKey(*contacts[i]));
+            }
+        }
+        for (const auto& operation : operations) {
+            if (operation.kind == BatchOperation::ADD &&
+                !keys.insert(duplicateKey(operation.contact)).second) {
+                std::cerr << "Контакт уже существует!" << std::endl;
+                return false;
+            }
+        }
+    }
+    
+    // Журнал отката: прежние версии измененных контактов. Удаления
+    // выполняются только после записи файла, добавленные контакты лежат
+    // в конце, поэтому откат не требует копии всего справочника.
+    struct UndoEntry {
+        size_t position;
+        ContactHandle before;
+    };
+    std::vector<UndoEntry> undoLog;
+    size_t oldSize = contacts.size();
+    
+    // События копятся отдельно и публикуются, только если пакет применен
+    std::vector<ChangeEvent> events;
+    for (const auto& operation : operations) {
+        if (operation.kind == BatchOperation::UPDATE) {
+            size_t position = slotTable[operation.id.slot].position;
+            ContactHandle& target = contacts[position];
+            events.push_back(ChangeEvent(ChangeEvent::UPDATED, operation.id,
+                                         changedFields(*target, operation.contact)));
+            undoLog.push_back(UndoEntry{position, std::move(target)});
+            target = std::make_shared<const Contact>(operation.contact);
+        } else if (operation.kind == BatchOperation::REMOVE) {
+            events.push_back(ChangeEvent(ChangeEvent::REMOVED, operation.id));
+        }
+    }
+    for (const auto& operation : operations) {
+        if (operation.kind == BatchOperation::ADD) {
+            contacts.push_back(std::make_shared<const Contact>(operation.contact));
+            ids.push_back(allocateId(contacts.size() - 1));
+            events.push_back(ChangeEvent(ChangeEvent::ADDED, ids.back()));
+        }
+    }
+    
+    // Удаляемые строки пропускаются при записи
+    if (!saveToFile(removed)) {
+        for (size_t i = oldSize; i < ids.size(); ++i) {
+            releaseId(ids[i]);
+        }
+        contacts.resize(oldSize);
+        ids.resize(oldSize);
+        // Один контакт мог меняться в пакете дважды - откат в обратном порядке
+        for (auto it = undoLog.rbegin(); it != undoLog.rend(); ++it) {
+            contacts[it->position] = std::move(it->before);
+        }
         return false;
     }
+    removed.resize(contacts.size(), false);
+    compactRemoved(removed);
     
-    contacts[index] = contact;
-    return saveToFile();
+    // Порядки сортировки перестраиваются один раз при следующем запросе
+    invalidateViews();
+    for (const auto& event : events) {
+        recordChange(event);
+    }
+    publishSnapshot();
+    return true;
+}
+
+size_t PhoneBook::removeIf(const std::function<bool(const Contact&)>& predicate) {
+    ChangeNotifier notifier(*this);
+    WriteGuard guard(rwLock);
+    std::vector<bool> removed(contacts.size(), false);
+    size_t count = 0;
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (!isDead(i) && predicate(*contacts[i])) {
+            removed[i] = true;
+            count++;
+        }
+    }
+    return removeMarked(removed, count);
+}
+
+size_t PhoneBook::removeMany(const std::vector<ContactId>& idsToRemove) {
+    ChangeNotifier notifier(*this);
+    WriteGuard guard(rwLock);
+    std::vector<bool> removed(contacts.size(), false);
+    size_t count = 0;
+    for (const auto& id : idsToRemove) {
+        size_t index;
+        if (locateId(id, index) && !removed[index]) {
+            removed[index] = true;
+            count++;
+        }
+    }
+    return removeMarked(removed, count);
+}
+
+size_t PhoneBook::removeMarked(const std::vector<bool>& removed, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    std::vector<size_t> indices;
+    if (tombstoneMode) {
+        for (size_t i = 0; i < removed.size(); ++i) {
+            if (removed[i]) {
+                indices.push_back(i);
+            }
+        }
+    }
+    // В режиме надгробий записи только помечаются, а в файл дописываются
+    // строки об удалении; если файл отстает от справочника, он
+    // переписывается целиком, как без надгробий
+    if (tombstoneMode && appendTombstones(indices)) {
+        for (size_t index : indices) {
+            recordChange(ChangeEvent(ChangeEvent::REMOVED, ids[index]));
+            releaseId(ids[index]);
+            markDead(index);
+        }
+        purgeRemovedFromViews();
+        publishSnapshot();
+        if (compactionDue()) {
+            scheduleCompaction();
+        }
+        return count;
+    }
+    // Сначала файл: если записать не удалось, справочник не меняется
+    if (!saveToFile(removed)) {
+        return 0;
+    }
+    for (size_t i = 0; i < removed.size(); ++i) {
+        if (removed[i]) {
+            recordChange(ChangeEvent(ChangeEvent::REMOVED, ids[i]));
+        }
+    }
+    compactRemoved(removed);
+    purgeRemovedFromViews();
+    publishSnapshot();
+    return count;
+}
+
+void PhoneBook::compactRemoved(const std::vector<bool>& removed) {
+    // Один проход: оставшиеся контакты сдвигаются к началу,
+    // помеченные надгробием удаляются вместе с отмеченными в removed
+    size_t kept = 0;
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (removed[i] || isDead(i)) {
+            releaseId(ids[i]);
+            continue;
+        }
+        if (kept != i) {
+            contacts[kept] = std::move(contacts[i]);
+            ids[kept] = ids[i];
+        }
+        kept++;
+    }
+    contacts.erase(contacts.begin() + kept, contacts.end());
+    ids.erase(ids.begin() + kept, ids.end());
+    tombstones.clear();
+    deadCount = 0;
+    updatePositions(0);
+}
+
+void PhoneBook::markDead(size_t index) {
+    if (tombstones.size() < contacts.size()) {
+        tombstones.resize(contacts.size(), false);
+    }
+    tombstones[index] = true;
+    deadCount++;
+}
+
+void PhoneBook::compactTombstones() {
+    if (deadCount > 0) {
+        compactRemoved(std::vector<bool>(contacts.size(), false));
+        recordChange(ChangeEvent(ChangeEvent::REORDERED));
+        // Новая версия: строки надгробий больше не дописываются к файлу,
+        // пока его не перепишет уплотнение; снимок строит вызывающий
+        ++version;
+    }
+}
+
+bool PhoneBook::compactionDue() const {
+    // Доля удаленных среди записей файла: помеченных в памяти и
+    // оставшихся от прошлых запусков
+    std::lock_guard<std::mutex> fileGuard(fileMutex);
+    return deadCount + staleRecords > compactThreshold * (contacts.size() + staleRecords);
+}
+
+void PhoneBook::scheduleCompaction() {
+    // Не больше одного уплотнения одновременно; предыдущий поток к этому
+    // моменту уже завершился или завершается
+    if (compactionRunning.exchange(true)) {
+        return;
+    }
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+    compactor = std::thread([this] {
+        compact();
+        compactionRunning = false;
+    });
+}
+
+void PhoneBook::compact() {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr compacted;
+    {
+        WriteGuard guard(rwLock);
+        // Идентификаторы живых контактов не меняются, порядки сортировки остаются верными
+        compactTombstones();
+        compacted = currentSnapshot();
+    }
+    saveSnapshot(compacted);
+}
+
+void PhoneBook::setTombstoneMode(bool enabled, double threshold) {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr compacted;
+    {
+        WriteGuard guard(rwLock);
+        tombstoneMode = enabled;
+        compactThreshold = threshold;
+        if (enabled) {
+            // Файл мог накопить удаленные записи в прошлых запусках
+            if (compactionDue()) {
+                scheduleCompaction();
+            }
+            return;
+        }
+        if (deadCount == 0) {
+            return;
+        }
+        compactTombstones();
+        compacted = currentSnapshot();
+    }
+    saveSnapshot(compacted);
+}
+
+size_t PhoneBook::getTombstoneCount() const {
+    ReadGuard guard(rwLock);
+    std::lock_guard<std::mutex> fileGuard(fileMutex);
+    return deadCount + staleRecords;
+}
+
+size_t PhoneBook::subscribe(const ChangeListener& listener) {
+    std::lock_guard<std::mutex> listenersGuard(listenersMutex);
+    size_t subscription = nextSubscription++;
+    listeners.push_back(std::make_pair(subscription, listener));
+    hasListeners = true;
+    return subscription;
+}
+
+void PhoneBook::unsubscribe(size_t subscription) {
+    std::lock_guard<std::mutex> dispatchGuard(dispatchMutex);
+    std::lock_guard<std::mutex> listenersGuard(listenersMutex);
+    for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+        if (it->first == subscription) {
+            listeners.erase(it);
+            break;
+        }
+    }
+    hasListeners = !listeners.empty();
+}
+
+thread_local PhoneBook::ChangeNotifier* PhoneBook::activeNotifier = nullptr;
+
+PhoneBook::ChangeNotifier::ChangeNotifier(PhoneBook& b) : book(b), outer(activeNotifier) {
+    activeNotifier = this;
+}
+
+PhoneBook::ChangeNotifier::~ChangeNotifier() {
+    activeNotifier = outer;
+    if (batch) {
+        book.deliverChanges(batch);
+    }
+}
+
+void PhoneBook::recordChange(const ChangeEvent& event) {
+    // Без подписчиков события не копятся
+    if (!hasListeners) {
+        return;
+    }
+    ChangeNotifier* notifier = activeNotifier;
+    while (notifier && &notifier->book != this) {
+        notifier = notifier->outer;
+    }
+    if (!notifier) {
+        return;
+    }
+    // Пакет пополняет только поток операции; доставляющий поток читает
+    // его после отметки complete под eventsMutex
+    if (!notifier->batch) {
+        notifier->batch = std::make_shared<EventBatch>();
+        std::lock_guard<std::mutex> eventsGuard(eventsMutex);
+        eventQueue.push_back(notifier->batch);
+    }
+    notifier->batch->events.push_back(event);
+    notifier->batch->events.back().version = version;
 }
 
-Contact* PhoneBook::getContact(size_t index) {
-    if (index >= contacts.size()) {
-        return nullptr;
+void PhoneBook::markSaved(size_t stale) {
+    std::lock_guard<std::mutex> fileGuard(fileMutex);
+    savedVersion = version;
+    staleRecords = stale;
+    unsavedChanges = false;
+}
+
+void PhoneBook::deliverChanges(const std::shared_ptr<EventBatch>& finished) {
+    {
+        std::lock_guard<std::mutex> eventsGuard(eventsMutex);
+        finished->complete = true;
+    }
+    // Доставка по одной: пакеты разных операций приходят в порядке изменений.
+    // Пакет, перед которым в очереди еще идущая операция, доставит она
+    std::lock_guard<std::mutex> dispatchGuard(dispatchMutex);
+    for (;;) {
+        std::shared_ptr<EventBatch> next;
+        {
+            std::lock_guard<std::mutex> eventsGuard(eventsMutex);
+            if (eventQueue.empty() || !eventQueue.front()->complete) {
+                return;
+            }
+            next = eventQueue.front();
+            eventQueue.pop_front();
+        }
+        std::vector<ChangeListener> targets;
+        {
+            std::lock_guard<std::mutex> listenersGuard(listenersMutex);
+            for (const auto& entry : listeners) {
+                targets.push_back(entry.second);
+            }
+        }
+        for (const auto& listener : targets) {
+            listener(next->events);
+        }
     }
-    return &contacts[index];
 }
 
-const Contact* PhoneBook::getContact(size_t index) const {
-    if (index >= contacts.size()) {
-        return nullptr;
+bool PhoneBook::isAlive(size_t index) const {
+    ReadGuard guard(rwLock);
+    return index < contacts.size() && !isDead(index);
+}
+
+ContactHandle PhoneBook::getContact(size_t index) const {
+    ReadGuard guard(rwLock);
+    if (index >= contacts.size() || isDead(index)) {
+        return ContactHandle();
+    }
+    return contacts[index];
+}
+
+ContactHandle PhoneBook::getContact(ContactId id) const {
+    ReadGuard guard(rwLock);
+    size_t index;
+    return locateId(id, index) ? contacts[index] : ContactHandle();
+}
+
+ContactId PhoneBook::getId(size_t index) const {
+    ReadGuard guard(rwLock);
+    if (index >= ids.size() || isDead(index)) {
+        return ContactId();
+    }
+    return ids[index];
+}
+
+bool PhoneBook::findIndex(ContactId id, size_t& index) const {
+    ReadGuard guard(rwLock);
+    return locateId(id, index);
+}
+
+bool PhoneBook::locateId(ContactId id, size_t& index) const {
+    if (id.slot >= slotTable.size()) {
+        return false;
+    }
+    const Slot& slot = slotTable[id.slot];
+    if (!slot.used || slot.generation != id.generation) {
+        return false;
+    }
+    index = slot.position;
+    return true;
+}
+
+ContactId PhoneBook::allocateId(size_t position) {
+    uint32_t slotIndex;
+    if (!freeSlots.empty()) {
+        slotIndex = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slotIndex = static_cast<uint32_t>(slotTable.size());
+        Slot slot = {0, 0, false};
+        slotTable.push_back(slot);
+    }
+    Slot& slot = slotTable[slotIndex];
+    slot.used = true;
+    slot.position = static_cast<uint32_t>(position);
+    return ContactId(slotIndex, slot.generation);
+}
+
+void PhoneBook::releaseId(ContactId id) {
+    Slot& slot = slotTable[id.slot];
+    // Идентификатор записи под надгробием уже освобожден
+    if (!slot.used || slot.generation != id.generation) {
+        return;
+    }
+    slot.used = false;
+    slot.generation++;
+    freeSlots.push_back(id.slot);
+}
+
+void PhoneBook::releaseAllIds() {
+    for (const auto& id : ids) {
+        releaseId(id);
+    }
+    ids.clear();
+}
+
+void PhoneBook::updatePositions(size_t from) {
+    for (size_t i = from; i < ids.size(); ++i) {
+        slotTable[ids[i].slot].position = static_cast<uint32_t>(i);
     }
-    return &contacts[index];
 }
 
 std::vector<Contact> PhoneBook::getAllContacts() const {
-    return contacts;
+    ReadGuard guard(rwLock);
+    std::vector<Contact> live;
+    live.reserve(contacts.size() - deadCount);
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (!isDead(i)) {
+            live.push_back(*contacts[i]);
+        }
+    }
+    return live;
+}
+
+ContactsView PhoneBook::view() const {
+    ReadGuard guard(rwLock);
+    return ContactsView(currentSnapshot());
+}
+
+ContactSelection PhoneBook::select(const std::vector<size_t>& indices) const {
+    ReadGuard guard(rwLock);
+    SnapshotPtr current = currentSnapshot();
+    std::vector<size_t> valid;
+    std::vector<size_t> positions;
+    valid.reserve(indices.size());
+    positions.reserve(indices.size());
+    for (size_t index : indices) {
+        if (index < contacts.size() && !isDead(index)) {
+            valid.push_back(index);
+            positions.push_back(current->positions[ids[index].slot]);
+        }
+    }
+    return ContactSelection(current, valid, positions);
 }
 
 size_t PhoneBook::getContactCount() const {
-    return contacts.size();
+    ReadGuard guard(rwLock);
+    return contacts.size() - deadCount;
 }
 
-std::vector<size_t> PhoneBook::searchByName(const std::string& query) const {
+std::vector<size_t> PhoneBook::skipDead(std::vector<size_t> indices) const {
+    if (deadCount > 0) {
+        indices.erase(std::remove_if(indices.begin(), indices.end(),
+            [this](size_t index) { return isDead(index); }), indices.end());
+    }
+    return indices;
+}
+
+static std::vector<size_t> findByName(const std::vector<ContactHandle>& contacts, const std::string& query) {
     std::vector<size_t> results;
     std::string lowerQuery = query;
     std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
     
+    // Один буфер на весь проход, чтобы не выделять память под каждое ФИО
+    std::string fullName;
     for (size_t i = 0; i < contacts.size(); ++i) {
-        std::string fullName = contacts[i].getLastName() + " " + 
-                               contacts[i].getFirstName() + " " + 
-                               contacts[i].getPatronymic();
-        std::transform(fullName.begin(), fullName.end(), fullName.begin(), ::tolower);
+        const Contact& contact = *contacts[i];
+        fullName.assign(contact.getLastName());
+        fullName += ' ';
+        fullName += contact.getFirstName();
+        fullName += ' ';
+        fullName += contact.getPatronymic();
         
-        if (fullName.find(lowerQuery) != std::string::npos) {
+        if (containsIgnoreCase(fullName, lowerQuery)) {
             results.push_back(i);
         }
     }
@@ -121,16 +1133,13 @@ std::vector<size_t> PhoneBook::searchByName(const std::string& query) const {
     return results;
 }
 
-std::vector<size_t> PhoneBook::searchByEmail(const std::string& query) const {
+static std::vector<size_t> findByEmail(const std::vector<ContactHandle>& contacts, const std::string& query) {
     std::vector<size_t> results;
     std::string lowerQuery = query;
     std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
     
     for (size_t i = 0; i < contacts.size(); ++i) {
-        std::string email = contacts[i].getEmail();
-        std::transform(email.begin(), email.end(), email.begin(), ::tolower);
-        
-        if (email.find(lowerQuery) != std::string::npos) {
+        if (containsIgnoreCase(contacts[i]->getEmail(), lowerQuery)) {
             results.push_back(i);
         }
     }
@@ -138,13 +1147,14 @@ std::vector<size_t> PhoneBook::searchByEmail(const std::string& query) const {
     return results;
 }
 
-std::vector<size_t> PhoneBook::searchByPhone(const std::string& query) const {
+static std::vector<size_t> findByPhone(const std::vector<ContactHandle>& contacts, const std::string& query) {
     std::vector<size_t> results;
+    PhoneQuery phoneQuery(query);
     
     for (size_t i = 0; i < contacts.size(); ++i) {
-        const auto& phones = contacts[i].getPhoneNumbers();
+        const auto& phones = contacts[i]->getPhoneNumbers();
         for (const auto& phone : phones) {
-            if (phone.number.find(query) != std::string::npos) {
+            if (phoneQuery.matches(phone)) {
                 results.push_back(i);
                 break;
             }
@@ -154,20 +1164,20 @@ std::vector<size_t> PhoneBook::searchByPhone(const std::string& query) const {
     return results;
 }
 
-std::vector<size_t> PhoneBook::searchMultiField(const std::string& query) const {
+static std::vector<size_t> findMultiField(const std::vector<ContactHandle>& contacts, const std::string& query) {
     std::vector<size_t> results;
     std::set<size_t> uniqueResults;
     
     // Поиск по имени
-    auto nameResults = searchByName(query);
+    auto nameResults = findByName(contacts, query);
     uniqueResults.insert(nameResults.begin(), nameResults.end());
     
     // Поиск по email
-    auto emailResults = searchByEmail(query);
+    auto emailResults = findByEmail(contacts, query);
     uniqueResults.insert(emailResults.begin(), emailResults.end());
     
     // Поиск по телефону
-    auto phoneResults = searchByPhone(query);
+    auto phoneResults = findByPhone(contacts, query);
     uniqueResults.insert(phoneResults.begin(), phoneResults.end());
     
     // Поиск по адресу
@@ -175,10 +1185,7 @@ std::vector<size_t> PhoneBook::searchMultiField(const std::string& query) const
     std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
     
     for (size_t i = 0; i < contacts.size(); ++i) {
-        std::string address = contacts[i].getAddress();
-        std::transform(address.begin(), address.end(), address.begin(), ::tolower);
-        
-        if (address.find(lowerQuery) != std::string::npos) {
+        if (containsIgnoreCase(contacts[i]->getAddress(), lowerQuery)) {
             uniqueResults.insert(i);
         }
     }
@@ -187,53 +1194,399 @@ std::vector<size_t> PhoneBook::searchMultiField(const std::string& query) const
     return results;
 }
 
+// Совпадение контакта с запросом хотя бы по одному полю - те же правила,
+// что в findMultiField; buffer - переиспользуемый буфер
+static bool matchesAnyField(const Contact& contact, const PhoneQuery& phoneQuery,
+                            const std::string& lowerQuery, std::string& buffer) {
+    buffer.assign(contact.getLastName());
+    buffer += ' ';
+    buffer += contact.getFirstName();
+    buffer += ' ';
+    buffer += contact.getPatronymic();
+    if (containsIgnoreCase(buffer, lowerQuery)) {
+        return true;
+    }
+    if (containsIgnoreCase(contact.getEmail(), lowerQuery) ||
+        containsIgnoreCase(contact.getAddress(), lowerQuery)) {
+        return true;
+    }
+    for (const auto& phone : contact.getPhoneNumbers()) {
+        if (phoneQuery.matches(phone)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<size_t> PhoneBook::searchByName(const std::string& query) const {
+    ReadGuard guard(rwLock);
+    return skipDead(findByName(contacts, query));
+}
+
+std::vector<size_t> PhoneBook::searchByEmail(const std::string& query) const {
+    ReadGuard guard(rwLock);
+    return skipDead(findByEmail(contacts, query));
+}
+
+std::vector<size_t> PhoneBook::searchByPhone(const std::string& query) const {
+    ReadGuard guard(rwLock);
+    return skipDead(findByPhone(contacts, query));
+}
+
+std::vector<size_t> PhoneBook::searchMultiField(const std::string& query) const {
+    ReadGuard guard(rwLock);
+    return skipDead(findMultiField(contacts, query));
+}
+
+PhoneBookSnapshot::PhoneBookSnapshot() : version(0), partial(false) {
+    std::fill(ordersValid, ordersValid + ORDER_COUNT, false);
+}
+
+bool PhoneBookSnapshot::findIndex(ContactId id, size_t& index) const {
+    if (id.slot >= positions.size() || positions[id.slot] == UINT32_MAX ||
+        ids[positions[id.slot]] != id) {
+        return false;
+    }
+    index = positions[id.slot];
+    return true;
+}
+
+const std::vector<uint32_t>& PhoneBookSnapshot::sortedOrder(SortField field, SortOrder order) const {
+    size_t v = sortViewIndex(field, order);
+    std::lock_guard<std::mutex> ordersGuard(ordersMutex);
+    if (!ordersValid[v]) {
+        // Устойчивая сортировка: равные ключи остаются в порядке справочника
+        SortSpec spec(1, SortCriterion(field, order));
+        std::vector<std::string> compositeKeys(contacts.size());
+        std::vector<const std::string*> keys(contacts.size());
+        std::vector<size_t> permutation(contacts.size());
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            compositeKeys[i] = makeCompositeKey(*contacts[i], spec);
+            keys[i] = &compositeKeys[i];
+            permutation[i] = i;
+        }
+        radixSortByKeys(permutation, keys);
+        orders[v].assign(permutation.begin(), permutation.end());
+        ordersValid[v] = true;
+    }
+    return orders[v];
+}
+
+std::vector<size_t> PhoneBookSnapshot::getPage(SortField field, SortOrder order, size_t offset, size_t limit) const {
+    const std::vector<uint32_t>& sorted = sortedOrder(field, order);
+    std::vector<size_t> page;
+    if (offset >= sorted.size()) {
+        return page;
+    }
+    // limit может быть любым, в том числе SIZE_MAX: offset + limit не вычисляется
+    size_t end = (limit > sorted.size() - offset) ? sorted.size() : offset + limit;
+    page.assign(sorted.begin() + offset, sorted.begin() + end);
+    return page;
+}
+
+std::vector<size_t> PhoneBookSnapshot::searchByName(const std::string& query) const {
+    return findByName(contacts, query);
+}
+
+std::vector<size_t> PhoneBookSnapshot::searchByEmail(const std::string& query) const {
+    return findByEmail(contacts, query);
+}
+
+std::vector<size_t> PhoneBookSnapshot::searchByPhone(const std::string& query) const {
+    return findByPhone(contacts, query);
+}
+
+std::vector<size_t> PhoneBookSnapshot::searchMultiField(const std::string& query) const {
+    return findMultiField(contacts, query);
+}
+
+std::vector<size_t> PhoneBookSnapshot::searchMultiField(const std::string& query, size_t from, size_t to) const {
+    std::vector<size_t> results;
+    std::string lowerQuery = query;
+    std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
+    PhoneQuery phoneQuery(query);
+    
+    std::string buffer;
+    to = std::min(to, contacts.size());
+    for (size_t i = from; i < to; ++i) {
+        if (matchesAnyField(*contacts[i], phoneQuery, lowerQuery, buffer)) {
+            results.push_back(i);
+        }
+    }
+    
+    return results;
+}
+
+void PhoneBook::enableSnapshots() {
+    WriteGuard guard(rwLock);
+    snapshotsEnabled = true;
+    publishSnapshot();
+}
+
+SnapshotPtr PhoneBook::snapshot() const {
+    if (snapshotsEnabled) {
+        return std::atomic_load(&published);
+    }
+    ReadGuard guard(rwLock);
+    return currentSnapshot();
+}
+
+void PhoneBook::publishSnapshot() {
+    ++version;
+    if (snapshotsEnabled) {
+        std::atomic_store(&published, buildSnapshot());
+    }
+}
+
+SnapshotPtr PhoneBook::currentSnapshot() const {
+    // Вызывается под rwLock: пока снимок строится, справочник не меняется
+    std::lock_guard<std::mutex> snapshotGuard(snapshotMutex);
+    SnapshotPtr current = std::atomic_load(&published);
+    if (current->getVersion() != version) {
+        current = buildSnapshot();
+        std::atomic_store(&published, current);
+    }
+    return current;
+}
+
+SnapshotPtr PhoneBook::buildSnapshot() const {
+    std::shared_ptr<PhoneBookSnapshot> next = std::make_shared<PhoneBookSnapshot>();
+    next->version = version;
+    next->partial = partiallyLoaded;
+    next->contacts.reserve(contacts.size() - deadCount);
+    next->ids.reserve(contacts.size() - deadCount);
+    next->positions.assign(slotTable.size(), UINT32_MAX);
+    // Снимок копирует только указатели: контакты неизменяемы и разделяются
+    // со справочником и предыдущими версиями
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (isDead(i)) {
+            continue;
+        }
+        next->positions[ids[i].slot] = static_cast<uint32_t>(next->contacts.size());
+        next->contacts.push_back(contacts[i]);
+        next->ids.push_back(ids[i]);
+    }
+    
+    // Поддерживаемые порядки переходят в снимок без сортировки
+    std::lock_guard<std::mutex> viewsGuard(viewsMutex);
+    for (size_t v = 0; v < SORT_VIEW_COUNT; ++v) {
+        if (!sortedIdsValid[v]) continue;
+        next->orders[v].reserve(sortedIds[v].size());
+        for (const auto& id : sortedIds[v]) {
+            next->orders[v].push_back(next->positions[id.slot]);
+        }
+        next->ordersValid[v] = true;
+    }
+    return next;
+}
+
 void PhoneBook::sortContacts(SortField field, SortOrder order) {
-    std::sort(contacts.begin(), contacts.end(), 
-        [field, order](const Contact& a, const Contact& b) {
-            bool less = false;
-            
-            switch (field) {
-                case SortField::FIRST_NAME:
-                    less = a.getFirstName() < b.getFirstName();
-                    break;
-                case SortField::LAST_NAME:
-                    less = a.getLastName() < b.getLastName();
-                    break;
-                case SortField::EMAIL:
-                    less = a.getEmail() < b.getEmail();
-                    break;
-                case SortField::BIRTH_DATE: {
-                    Date dateA = a.getBirthDate();
-                    Date dateB = b.getBirthDate();
-                    if (dateA.year != dateB.year) less = dateA.year < dateB.year;
-                    else if (dateA.month != dateB.month) less = dateA.month < dateB.month;
-                    else less = dateA.day < dateB.day;
-                    break;
-                }
+    sortContacts(SortSpec(1, SortCriterion(field, order)));
+}
+
+void PhoneBook::sortContacts(const SortSpec& spec) {
+    ChangeNotifier notifier(*this);
+    SnapshotPtr sorted;
+    {
+        WriteGuard guard(rwLock);
+        // Сортировка все равно переставляет все записи - заодно убираем надгробия
+        compactTombstones();
+        // Составной ключ строится один раз на контакт, после чего контакты
+        // сравниваются только побайтно, без разбора критериев
+        std::vector<std::string> compositeKeys(contacts.size());
+        std::vector<const std::string*> keys(contacts.size());
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            compositeKeys[i] = makeCompositeKey(*contacts[i], spec);
+            keys[i] = &compositeKeys[i];
+        }
+        
+        std::vector<size_t> permutation(contacts.size());
+        for (size_t i = 0; i < permutation.size(); ++i) {
+            permutation[i] = i;
+        }
+        
+        // Поразрядная сортировка устойчива: равные контакты сохраняют порядок
+        radixSortByKeys(permutation, keys);
+        applyPermutation(permutation);
+        recordChange(ChangeEvent(ChangeEvent::REORDERED));
+        sorted = currentSnapshot();
+    }
+    
+    saveSnapshot(sorted);
+}
+
+void PhoneBook::applyPermutation(const std::vector<size_t>& permutation) {
+    std::vector<ContactHandle> sorted;
+    std::vector<ContactId> permutedIds;
+    sorted.reserve(contacts.size());
+    permutedIds.reserve(ids.size());
+    for (size_t index : permutation) {
+        sorted.push_back(std::move(contacts[index]));
+        permutedIds.push_back(ids[index]);
+    }
+    contacts.swap(sorted);
+    ids.swap(permutedIds);
+    updatePositions(0);
+    // Равные по полю контакты в порядках идут по позиции, а она изменилась
+    invalidateViews();
+    publishSnapshot();
+}
+
+SortedView PhoneBook::sortedView(SortField field, SortOrder order) const {
+    ReadGuard guard(rwLock);
+    // Поддерживаемый порядок переходит в следующие снимки без сортировки
+    sortedOrder(field, order);
+    SnapshotPtr current = currentSnapshot();
+    return SortedView(*this, current, current->sortedOrder(field, order));
+}
+
+const std::vector<ContactId>& PhoneBook::sortedOrder(SortField field, SortOrder order) const {
+    // Порядок строится лениво; читатели могут прийти сюда одновременно
+    std::lock_guard<std::mutex> viewsGuard(viewsMutex);
+    size_t v = sortViewIndex(field, order);
+    if (!sortedIdsValid[v]) {
+        sortedIds[v].clear();
+        sortedIds[v].reserve(ids.size() - deadCount);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (!isDead(i)) {
+                sortedIds[v].push_back(ids[i]);
             }
-            
-            return (order == SortOrder::ASCENDING) ? less : !less;
-        });
+        }
+        std::sort(sortedIds[v].begin(), sortedIds[v].end(),
+            [this, v](ContactId a, ContactId b) { return viewLess(v, a, b); });
+        sortedIdsValid[v] = true;
+    }
+    return sortedIds[v];
+}
+
+std::vector<size_t> PhoneBook::getPage(const SortSpec& spec, size_t offset, size_t limit) const {
+    ReadGuard guard(rwLock);
+    std::vector<size_t> page;
+    size_t liveCount = contacts.size() - deadCount;
+    if (offset >= liveCount || limit == 0) {
+        return page;
+    }
+    // limit может быть любым, в том числе SIZE_MAX: offset + limit не вычисляется
+    size_t end = (limit > liveCount - offset) ? liveCount : offset + limit;
+    
+    // Если порядок по этому полю уже поддерживается, страница читается из него
+    if (spec.size() == 1 && hasSortedView(spec[0].field, spec[0].order)) {
+        const std::vector<ContactId>& sorted = sortedOrder(spec[0].field, spec[0].order);
+        for (size_t i = offset; i < end; ++i) {
+            page.push_back(slotTable[sorted[i].slot].position);
+        }
+        return page;
+    }
     
-    saveToFile();
+    std::vector<std::string> keys(contacts.size());
+    std::vector<size_t> permutation;
+    permutation.reserve(liveCount);
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (!isDead(i)) {
+            keys[i] = makeCompositeKey(*contacts[i], spec);
+            permutation.push_back(i);
+        }
+    }
+    
+    // При равных ключах порядок - как в справочнике (как у устойчивой сортировки)
+    auto less = [&keys](size_t a, size_t b) {
+        int cmp = keys[a].compare(keys[b]);
+        return cmp < 0 || (cmp == 0 && a < b);
+    };
+    
+    // Отбираем end наименьших, затем среди них - окно [offset, end)
+    // и сортируем только его: O(n + k log k)
+    if (end < permutation.size()) {
+        std::nth_element(permutation.begin(), permutation.begin() + end, permutation.end(), less);
+    }
+    if (offset > 0) {
+        std::nth_element(permutation.begin(), permutation.begin() + offset, permutation.begin() + end, less);
+    }
+    std::sort(permutation.begin() + offset, permutation.begin() + end, less);
+    
+    page.assign(permutation.begin() + offset, permutation.begin() + end);
+    return page;
+}
+
+bool PhoneBook::hasSortedView(SortField field, SortOrder order) const {
+    std::lock_guard<std::mutex> viewsGuard(viewsMutex);
+    return sortedIdsValid[sortViewIndex(field, order)];
+}
+
+bool PhoneBook::viewLess(size_t view, ContactId a, ContactId b) const {
+    SortField field = static_cast<SortField>(view / 2);
+    bool descending = (view % 2) != 0;
+    size_t positionA = slotTable[a.slot].position;
+    size_t positionB = slotTable[b.slot].position;
+    if (lessByField(*contacts[positionA], *contacts[positionB], field)) return !descending;
+    if (lessByField(*contacts[positionB], *contacts[positionA], field)) return descending;
+    // Равные по полю - в порядке справочника в обоих направлениях. Новые
+    // контакты добавляются в конец, удаление и уплотнение этот порядок
+    // не меняют, а перестановка при сортировке сбрасывает порядки
+    return positionA < positionB;
+}
+
+void PhoneBook::insertIntoViews(ContactId id) {
+    for (size_t v = 0; v < SORT_VIEW_COUNT; ++v) {
+        if (!sortedIdsValid[v]) continue;
+        auto it = std::upper_bound(sortedIds[v].begin(), sortedIds[v].end(), id,
+            [this, v](ContactId a, ContactId b) { return viewLess(v, a, b); });
+        sortedIds[v].insert(it, id);
+    }
+}
+
+void PhoneBook::removeFromViews(ContactId id) {
+    for (size_t v = 0; v < SORT_VIEW_COUNT; ++v) {
+        if (!sortedIdsValid[v]) continue;
+        auto it = std::lower_bound(sortedIds[v].begin(), sortedIds[v].end(), id,
+            [this, v](ContactId a, ContactId b) { return viewLess(v, a, b); });
+        if (it != sortedIds[v].end() && *it == id) {
+            sortedIds[v].erase(it);
+        }
+    }
+}
+
+void PhoneBook::purgeRemovedFromViews() {
+    // Удаленные идентификаторы больше не находятся в таблице ячеек
+    for (size_t v = 0; v < SORT_VIEW_COUNT; ++v) {
+        if (!sortedIdsValid[v]) continue;
+        auto& order = sortedIds[v];
+        order.erase(std::remove_if(order.begin(), order.end(),
+            [this](ContactId id) {
+                const Slot& slot = slotTable[id.slot];
+                return !slot.used || slot.generation != id.generation;
+            }), order.end());
+    }
+}
+
+void PhoneBook::invalidateViews() {
+    for (size_t v = 0; v < SORT_VIEW_COUNT; ++v) {
+        sortedIds[v].clear();
+        sortedIdsValid[v] = false;
+    }
 }
 
 bool PhoneBook::save() const {
-    return saveToFile();
+    return saveSnapshot(snapshot());
 }
 
 bool PhoneBook::reload() {
+    ChangeNotifier notifier(*this);
+    WriteGuard guard(rwLock);
     return loadFromFile();
 }
 
 bool PhoneBook::exportToFile(const std::string& filename) const {
+    ReadGuard guard(rwLock);
     std::ofstream file(filename);
     if (!file.is_open()) {
         return false;
     }
     
-    for (const auto& contact : contacts) {
-        file << contact.serialize() << std::endl;
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (!isDead(i)) {
+            file << contacts[i]->serialize() << std::endl;
+        }
     }
     
     file.close();
@@ -248,31 +1601,49 @@ bool PhoneBook::importFromFile(const std::string& filename) {
     
     std::string line;
     std::vector<Contact> newContacts;
+    newContacts.reserve(countLines(file));
     
     while (std::getline(file, line)) {
         if (!line.empty()) {
             Contact contact;
             if (contact.deserialize(line)) {
-                newContacts.push_back(contact);
+                newContacts.push_back(std::move(contact));
             }
         }
     }
     
     file.close();
     
-    // Добавляем новые контакты
-    for (const auto& contact : newContacts) {
-        addContact(contact);
+    // Добавляем новые контакты и сохраняем файл один раз
+    ChangeNotifier notifier(*this);
+    SnapshotPtr changed;
+    {
+        WriteGuard guard(rwLock);
+        mergeContacts(newContacts);
+        publishSnapshot();
+        changed = currentSnapshot();
     }
-    
-    return true;
+    return saveSnapshot(changed);
 }
 
 void PhoneBook::clear() {
-    contacts.clear();
-    saveToFile();
+    ChangeNotifier notifier(*this);
+    SnapshotPtr cleared;
+    {
+        WriteGuard guard(rwLock);
+        contacts.clear();
+        invalidateViews();
+        releaseAllIds();
+        tombstones.clear();
+        deadCount = 0;
+        recordChange(ChangeEvent(ChangeEvent::RELOADED));
+        publishSnapshot();
+        cleared = currentSnapshot();
+    }
+    saveSnapshot(cleared);
 }
 
 bool PhoneBook::isEmpty() const {
-    return contacts.empty();
+    ReadGuard guard(rwLock);
+    return contacts.size() == deadCount;
 }
\ No newline at end of file
@@ -2,10 +2,18 @@
 #define PHONEBOOK_H
 
 #include "Contact.h"
+#include "ReadWriteLock.h"
 #include <vector>
 #include <string>
 #include <memory>
 #include <functional>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
 
 enum class SortField {
     FIRST_NAME,
@@ -19,28 +27,446 @@ enum class SortOrder {
     DESCENDING
 };
 
+// Один критерий составной сортировки
+struct SortCriterion {
+    SortField field;
+    SortOrder order;
+    
+    SortCriterion(SortField f, SortOrder o = SortOrder::ASCENDING) : field(f), order(o) {}
+};
+
+// Упорядоченный список критериев: следующий учитывается при равенстве предыдущих
+typedef std::vector<SortCriterion> SortSpec;
+
+// Устойчивый идентификатор контакта: номер ячейки и поколение.
+// Не меняется при сортировке и удалении других контактов; после удаления
+// самого контакта поколение ячейки растет и старый идентификатор
+// перестает находить запись.
+struct ContactId {
+    uint32_t slot;
+    uint32_t generation;
+    
+    ContactId() : slot(UINT32_MAX), generation(0) {}
+    ContactId(uint32_t s, uint32_t g) : slot(s), generation(g) {}
+    
+    bool isValid() const { return slot != UINT32_MAX; }
+    bool operator==(const ContactId& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const ContactId& other) const { return !(*this == other); }
+    
+    // Упаковка в одно число (например, для хранения в элементах списка Qt)
+    uint64_t toKey() const { return (static_cast<uint64_t>(generation) << 32) | slot; }
+    static ContactId fromKey(uint64_t key) {
+        return ContactId(static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32));
+    }
+};
+
+// Контакт справочника. Объекты неизменяемы: изменение контакта заменяет
+// указатель на новый объект, поэтому ранее полученный ContactHandle
+// остается действительным и видит прежнюю версию
+typedef std::shared_ptr<const Contact> ContactHandle;
+
+// Неизменяемая версия справочника: контакты, их идентификаторы и порядки
+// сортировки. Потоки-читатели получают снимок через PhoneBook::snapshot()
+// и работают с ним без блокировок; изменения справочника создают новую
+// версию. Снимок хранит те же ContactHandle, что и справочник, поэтому
+// публикация копирует только указатели.
+class PhoneBookSnapshot {
+private:
+    static const size_t ORDER_COUNT = 8;  // поле и направление, см. getPage()
+    
+    std::vector<ContactHandle> contacts;
+    std::vector<ContactId> ids;
+    std::vector<uint32_t> positions;    // по номеру ячейки: индекс в снимке
+    uint64_t version;
+    bool partial;                       // файл был прочитан не полностью
+    
+    // Порядки сортировки в индексах снимка. Поддерживаемые справочником
+    // копируются при публикации, остальные строятся при первом запросе.
+    mutable std::vector<uint32_t> orders[ORDER_COUNT];
+    mutable bool ordersValid[ORDER_COUNT];
+    mutable std::mutex ordersMutex;
+    
+    // Порядок сортировки целиком; построенный порядок больше не меняется
+    const std::vector<uint32_t>& sortedOrder(SortField field, SortOrder order) const;
+    
+    friend class PhoneBook;
+
+public:
+    PhoneBookSnapshot();
+    
+    uint64_t getVersion() const { return version; }
+    size_t getContactCount() const { return contacts.size(); }
+    const Contact& getContact(size_t index) const { return *contacts[index]; }
+    ContactHandle getContactHandle(size_t index) const { return contacts[index]; }
+    ContactId getId(size_t index) const { return ids[index]; }
+    bool findIndex(ContactId id, size_t& index) const;
+    
+    // Индексы контактов с позиции offset по offset + limit в порядке
+    // сортировки; равные по полю идут в порядке справочника
+    std::vector<size_t> getPage(SortField field, SortOrder order, size_t offset, size_t limit) const;
+    
+    std::vector<size_t> searchByName(const std::string& query) const;
+    std::vector<size_t> searchByEmail(const std::string& query) const;
+    std::vector<size_t> searchByPhone(const std::string& query) const;
+    std::vector<size_t> searchMultiField(const std::string& query) const;
+    // То же по диапазону [from, to), чтобы искать частями и прерывать
+    // устаревший поиск между ними
+    std::vector<size_t> searchMultiField(const std::string& query, size_t from, size_t to) const;
+};
+
+typedef std::shared_ptr<const PhoneBookSnapshot> SnapshotPtr;
+
+// Все контакты справочника на момент вызова view(). Держит снимок, поэтому
+// остается действительным и не меняется, даже если справочник изменяют
+// другие потоки; блокировка справочника на время работы с ним не нужна.
+class ContactsView {
+private:
+    SnapshotPtr snapshot;
+
+public:
+    class const_iterator {
+    private:
+        const PhoneBookSnapshot* owner;
+        size_t position;
+    
+    public:
+        const_iterator(const PhoneBookSnapshot* snap, size_t pos) : owner(snap), position(pos) {}
+        
+        const Contact& operator*() const { return owner->getContact(position); }
+        const Contact* operator->() const { return &owner->getContact(position); }
+        const_iterator& operator++() { ++position; return *this; }
+        bool operator==(const const_iterator& other) const { return position == other.position; }
+        bool operator!=(const const_iterator& other) const { return position != other.position; }
+        ContactId id() const { return owner->getId(position); }
+    };
+    
+    explicit ContactsView(const SnapshotPtr& snap) : snapshot(snap) {}
+    
+    const_iterator begin() const { return const_iterator(snapshot.get(), 0); }
+    const_iterator end() const { return const_iterator(snapshot.get(), snapshot->getContactCount()); }
+    size_t size() const { return snapshot->getContactCount(); }
+    bool empty() const { return snapshot->getContactCount() == 0; }
+    const Contact& operator[](size_t position) const { return snapshot->getContact(position); }
+    ContactId idAt(size_t position) const { return snapshot->getId(position); }
+};
+
+// Подмножество контактов по списку индексов (например, результаты поиска).
+// Как и ContactsView, держит снимок и не зависит от дальнейших изменений;
+// сами контакты не копируются.
+class ContactSelection {
+private:
+    SnapshotPtr snapshot;
+    std::vector<size_t> indices;     // индексы в справочнике на момент select()
+    std::vector<size_t> positions;   // те же контакты в снимке
+
+public:
+    class const_iterator {
+    private:
+        const ContactSelection* owner;
+        size_t position;
+    
+    public:
+        const_iterator(const ContactSelection* sel, size_t pos) : owner(sel), position(pos) {}
+        
+        const Contact& operator*() const { return (*owner)[position]; }
+        const Contact* operator->() const { return &(*owner)[position]; }
+        const_iterator& operator++() { ++position; return *this; }
+        bool operator==(const const_iterator& other) const { return position == other.position; }
+        bool operator!=(const const_iterator& other) const { return position != other.position; }
+        // Индекс контакта в справочнике на момент select()
+        size_t index() const { return owner->indexAt(position); }
+        ContactId id() const { return owner->idAt(position); }
+    };
+    
+    ContactSelection(const SnapshotPtr& snap, const std::vector<size_t>& idx, const std::vector<size_t>& pos)
+        : snapshot(snap), indices(idx), positions(pos) {}
+    
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, indices.size()); }
+    size_t size() const { return indices.size(); }
+    bool empty() const { return indices.empty(); }
+    const Contact& operator[](size_t position) const { return snapshot->getContact(positions[position]); }
+    size_t indexAt(size_t position) const { return indices[position]; }
+    ContactId idAt(size_t position) const { return snapshot->getId(positions[position]); }
+};
+
+class SortedView;
+class PhoneBook;
+
+// Изменение справочника для подписчиков (см. PhoneBook::subscribe)
+struct ChangeEvent {
+    enum Kind {
+        ADDED,
+        UPDATED,
+        REMOVED,
+        REORDERED,  // изменились индексы; идентификаторы и данные прежние
+        RELOADED    // содержимое заменено целиком
+    };
+    
+    // Биты changedFields для UPDATED
+    enum Field {
+        FIRST_NAME = 1 << 0,
+        LAST_NAME = 1 << 1,
+        PATRONYMIC = 1 << 2,
+        ADDRESS = 1 << 3,
+        BIRTH_DATE = 1 << 4,
+        EMAIL = 1 << 5,
+        PHONES = 1 << 6
+    };
+    
+    Kind kind;
+    ContactId id;               // для ADDED, UPDATED и REMOVED
+    uint32_t changedFields;
+    // Версия справочника до изменения: снимки с большей версией
+    // (PhoneBookSnapshot::getVersion()) его уже отражают
+    uint64_t version;
+    
+    ChangeEvent(Kind k, ContactId i = ContactId(), uint32_t fields = 0)
+        : kind(k), id(i), changedFields(fields), version(0) {}
+};
+
+// Получает все события одной операции разом (пакет транзакции,
+// массового удаления, импорта или части загрузки)
+typedef std::function<void(const std::vector<ChangeEvent>&)> ChangeListener;
+
+// Одна операция пакетного изменения
+struct BatchOperation {
+    enum Kind {
+        ADD,
+        UPDATE,
+        REMOVE
+    };
+    
+    Kind kind;
+    ContactId id;       // для UPDATE и REMOVE
+    Contact contact;    // для ADD и UPDATE
+};
+
+// Пакет изменений справочника. Операции накапливаются и применяются
+// в commit() все вместе: одна проверка, одно обновление индексов и
+// одна запись в файл. Если хотя бы одна операция недопустима или файл
+// не удалось записать, справочник остается без изменений.
+class PhoneBookTransaction {
+private:
+    PhoneBook& book;
+    std::vector<BatchOperation> operations;
+
+public:
+    explicit PhoneBookTransaction(PhoneBook& phoneBook) : book(phoneBook) {}
+    
+    void add(const Contact& contact);
+    void update(ContactId id, const Contact& contact);
+    void remove(ContactId id);
+    
+    bool commit();
+    void rollback() { operations.clear(); }
+    size_t size() const { return operations.size(); }
+};
+
+// Справочник можно использовать из нескольких потоков: чтение идет
+// параллельно, изменения - по одному. Индексы остаются действительными
+// только пока справочник не меняется; для многопоточной работы используйте
+// идентификаторы. Контакты из getContact(), а также view(), select(),
+// sortedView() и snapshot() от последующих изменений не зависят.
+//
+// В режиме надгробий (setTombstoneMode) удаление только помечает запись,
+// а место освобождает фоновое уплотнение, которое сдвигает индексы
+// в любой момент. В этом режиме обращайтесь к контактам по ContactId;
+// view() показывает и помеченные записи (см. isAlive()).
 class PhoneBook {
 private:
-    std::vector<Contact> contacts;
+    // Ячейка таблицы идентификаторов
+    struct Slot {
+        uint32_t generation;
+        uint32_t position;  // индекс контакта в contacts
+        bool used;
+    };
+    
+    // Контакты разделяются со снимками; изменение копирует один контакт
+    std::vector<ContactHandle> contacts;
+    std::vector<ContactId> ids;         // ids[i] - идентификатор contacts[i]
+    std::vector<Slot> slotTable;
+    std::vector<uint32_t> freeSlots;
     std::string fileName;
     
+    // Поддерживаемые порядки сортировки для каждого поля и направления
+    // (индекс - viewIndex()). Равные по полю контакты идут в порядке
+    // справочника, как после устойчивой sortContacts(). Строятся при первом
+    // запросе и далее обновляются при изменениях.
+    static const size_t SORT_VIEW_COUNT = 8;
+    mutable std::vector<ContactId> sortedIds[SORT_VIEW_COUNT];
+    mutable bool sortedIdsValid[SORT_VIEW_COUNT];
+    
+    // Последний построенный снимок. version растет при каждом изменении;
+    // после enableSnapshots() снимок публикуется сразу, иначе строится
+    // при первом запросе (view(), select(), snapshot())
+    mutable SnapshotPtr published;
+    std::atomic<bool> snapshotsEnabled;
+    uint64_t version;
+    
+    // Синхронизация: rwLock защищает контакты, идентификаторы и порядки;
+    // viewsMutex - ленивое построение порядков читателями;
+    // snapshotMutex - построение снимков читателями;
+    // fileMutex - запись файла справочника
+    mutable ReadWriteLock rwLock;
+    mutable std::mutex viewsMutex;
+    mutable std::mutex snapshotMutex;
+    mutable std::mutex fileMutex;
+    
+    // Режим надгробий: удаленные записи помечаются, а не вырезаются.
+    // tombstones может быть короче contacts - недостающие записи живые.
+    std::vector<bool> tombstones;
+    size_t deadCount;
+    bool tombstoneMode;
+    double compactThreshold;    // доля удаленных, после которой запускается уплотнение
+    // Записи файла, удаленные строками надгробий в прошлых запусках;
+    // обнуляется полной перезаписью файла (под fileMutex)
+    mutable size_t staleRecords;
+    std::thread compactor;
+    std::atomic<bool> compactionRunning;
+    
+    // Файл прочитан не полностью (идет или прервана загрузка частями);
+    // пока флаг установлен, справочник не записывается в файл
+    bool partiallyLoaded;
+    
+    // Последнее изменение не попало в файл; деструктор переписывает файл
+    // только в этом случае. Меняется под fileMutex.
+    mutable bool unsavedChanges;
+    
+    // Версия справочника в файле (под fileMutex). Изменения пишутся после
+    // снятия блокировки и могут прийти к файлу не по порядку: снимок старше
+    // записанной версии файл не перезаписывает.
+    mutable uint64_t savedVersion;
+    
+    // Отложенная запись (setDeferredSaves): файл переписывает поток saver
+    // из снимка; saveQueued - с последней записи были изменения
+    bool deferredSaves;
+    mutable bool saveQueued;
+    std::thread saver;
+    mutable std::mutex saverMutex;
+    mutable std::condition_variable saveWake;
+    
+    // События одной операции. Пакет встает в очередь при первом событии,
+    // под rwLock, то есть в порядке изменений, а доставляется, когда
+    // операция завершилась и все пакеты перед ним доставлены
+    struct EventBatch {
+        std::vector<ChangeEvent> events;
+        bool complete;  // под eventsMutex
+        EventBatch() : complete(false) {}
+    };
+    
+    // Подписчики и очередь пакетов событий
+    std::vector<std::pair<size_t, ChangeListener> > listeners;
+    size_t nextSubscription;
+    std::atomic<bool> hasListeners;
+    std::deque<std::shared_ptr<EventBatch> > eventQueue;
+    std::mutex listenersMutex;
+    std::mutex eventsMutex;
+    std::mutex dispatchMutex;
+    
+    // Собирает события открытого метода и доставляет их при выходе из него,
+    // уже после снятия rwLock, поэтому объявляется раньше WriteGuard.
+    // У каждой операции свой пакет: параллельные операции в других потоках
+    // не подмешивают в него свои события
+    struct ChangeNotifier {
+        PhoneBook& book;
+        ChangeNotifier* outer;  // операция, внутри которой начата эта
+        std::shared_ptr<EventBatch> batch;
+        explicit ChangeNotifier(PhoneBook& b);
+        ~ChangeNotifier();
+    };
+    // Текущая операция потока; recordChange() пишет в ее пакет
+    static thread_local ChangeNotifier* activeNotifier;
+    
+    // Далее - методы без захвата rwLock, вызываются под уже взятой блокировкой
+    ContactId allocateId(size_t position);
+    void releaseId(ContactId id);
+    void releaseAllIds();
+    void updatePositions(size_t from);
+    void applyPermutation(const std::vector<size_t>& permutation);
+    
+    bool viewLess(size_t view, ContactId a, ContactId b) const;
+    void insertIntoViews(ContactId id);
+    void removeFromViews(ContactId id);
+    void invalidateViews();
+    bool hasSortedView(SortField field, SortOrder order) const;
+    const std::vector<ContactId>& sortedOrder(SortField field, SortOrder order) const;
+    bool locateId(ContactId id, size_t& index) const;
+    // changed - снимок для записи после снятия блокировки (пустой, если
+    // удаление уже дописано в файл строкой надгробия)
+    bool removeAt(size_t index, SnapshotPtr& changed);
+    bool updateAt(size_t index, const Contact& contact);
+    void publishSnapshot();
+    SnapshotPtr buildSnapshot() const;
+    SnapshotPtr currentSnapshot() const;
+    
+    bool isDead(size_t index) const { return index < tombstones.size() && tombstones[index]; }
+    bool containsLive(const Contact& contact) const;
+    std::vector<size_t> skipDead(std::vector<size_t> indices) const;
+    void markDead(size_t index);
+    void compactTombstones();
+    bool compactionDue() const;
+    void scheduleCompaction();
+    void recordChange(const ChangeEvent& event);
+    void deliverChanges(const std::shared_ptr<EventBatch>& finished);
+    
     bool loadFromFile();
-    bool saveToFile() const;
+    void appendLoaded(std::vector<ContactHandle>& chunk);
+    void dropDeletedLoaded(const std::unordered_set<std::string>& deletedKeys);
+    // Запись пакета под блокировкой: пакет применяется только после
+    // успешной записи. skipped[i] - строка i не записывается (удаляется пакетом)
+    bool saveToFile(const std::vector<bool>& skipped) const;
+    // Остальные изменения пишутся из снимка уже после снятия блокировки
+    bool saveSnapshot(const SnapshotPtr& snapshot) const;
+    bool writeSnapshot(const PhoneBookSnapshot& snapshot) const;
+    bool appendTombstones(const std::vector<size_t>& indices) const;
+    void markSaved(size_t stale = 0);
+    bool queueSave() const;
+    void runSaver();
+    void mergeContacts(std::vector<Contact>& newContacts);
+    void compactRemoved(const std::vector<bool>& removed);
+    size_t removeMarked(const std::vector<bool>& removed, size_t count);
+    void purgeRemovedFromViews();
+    bool applyBatch(const std::vector<BatchOperation>& operations);
     
+    friend class PhoneBookTransaction;
+
 public:
-    PhoneBook(const std::string& file = "phonebook.txt");
+    // loadNow = false - справочник создается пустым, файл загружается
+    // позже через loadIncrementally() (например, в фоновом потоке)
+    PhoneBook(const std::string& file = "phonebook.txt", bool loadNow = true);
     ~PhoneBook();
     
     // Основные операции
     bool addContact(const Contact& contact);
     bool removeContact(size_t index);
     bool updateContact(size_t index, const Contact& contact);
+    bool removeContact(ContactId id);
+    bool updateContact(ContactId id, const Contact& contact);
+    PhoneBookTransaction transaction();
+    
+    // Массовое удаление за один проход с одной записью файла.
+    // Возвращают число удаленных контактов; если файл записать не удалось,
+    // ничего не удаляется и возвращается 0. Предикат вызывается под
+    // блокировкой записи и не должен обращаться к справочнику.
+    size_t removeIf(const std::function<bool(const Contact&)>& predicate);
+    size_t removeMany(const std::vector<ContactId>& idsToRemove);
     
-    // Получение данных
-    Contact* getContact(size_t index);
-    const Contact* getContact(size_t index) const;
-    std::vector<Contact> getAllContacts() const;
+    // Получение данных. Пустой ContactHandle - контакта нет; изменять
+    // контакт можно только через updateContact()
+    ContactHandle getContact(size_t index) const;
+    ContactHandle getContact(ContactId id) const;
+    ContactId getId(size_t index) const;
+    bool findIndex(ContactId id, size_t& index) const;
+    // Ключ дубликата "фамилия|имя|почта" - те же поля, что сравнивает
+    // Contact::operator==. В отличие от ContactId, не зависит от порядка
+    // загрузки и одинаков в разных запусках
+    static std::string duplicateKey(const Contact& contact);
+    std::vector<Contact> getAllContacts() const;  // полная копия
+    ContactsView view() const;
+    ContactSelection select(const std::vector<size_t>& indices) const;
     size_t getContactCount() const;
+    bool isAlive(size_t index) const;
     
     // Поиск
     std::vector<size_t> searchByName(const std::string& query) const;
@@ -50,10 +476,56 @@ public:
     
     // Сортировка
     void sortContacts(SortField field, SortOrder order = SortOrder::ASCENDING);
+    void sortContacts(const SortSpec& spec);
+    // Упорядоченное представление без перестановки контактов и записи в файл
+    SortedView sortedView(SortField field, SortOrder order = SortOrder::ASCENDING) const;
+    // Индексы контактов с позиции offset по offset + limit в порядке spec
+    // (без сортировки всего справочника)
+    std::vector<size_t> getPage(const SortSpec& spec, size_t offset, size_t limit) const;
+    
+    // Снимки для чтения из других потоков; snapshot() можно вызывать из
+    // любого потока. После enableSnapshots() каждое изменение сразу
+    // публикует новую версию и snapshot() не берет блокировку.
+    void enableSnapshots();
+    SnapshotPtr snapshot() const;
+    
+    // Режим надгробий: removeContact(), removeIf(), removeMany() и пакеты
+    // из одних удалений помечают записи и дописывают в файл строки об
+    // удалении; когда доля удаленных записей в файле (в том числе
+    // оставшихся от прошлых запусков) превышает threshold, фоновый поток
+    // уплотняет справочник и перезаписывает файл. Выключение режима
+    // уплотняет справочник сразу.
+    void setTombstoneMode(bool enabled, double threshold = 0.25);
+    void compact();
+    // Удаленные записи, которые еще хранятся в файле до уплотнения
+    size_t getTombstoneCount() const;
+    
+    // Отложенная запись для сервера: изменения не ждут записи файла, его
+    // переписывает фоновый поток, и все изменения, пришедшие за время
+    // предыдущей записи, попадают в одну следующую. Ошибка записи выводится
+    // в stderr и не откатывает изменения; запись повторяется при следующем
+    // изменении и при уничтожении справочника. Выключение дожидается
+    // записи последних изменений.
+    void setDeferredSaves(bool enabled);
+    
+    // Подписка на изменения. Обработчик получает события каждой операции
+    // отдельным пакетом, пакеты - в порядке изменений; откаченная операция
+    // событий не дает. Вызывается в потоке, изменившем справочник, после
+    // снятия блокировки; читать справочник из него можно, изменять - нельзя.
+    // Возвращает номер подписки для unsubscribe().
+    size_t subscribe(const ChangeListener& listener);
+    // Дожидается доставки, которая идет в других потоках: после возврата
+    // обработчик больше не вызывается. Из обработчика не вызывать
+    void unsubscribe(size_t subscription);
     
     // Работа с файлами
     bool save() const;
     bool reload();
+    // Загрузка файла частями по chunkSize строк: после каждой части контакты
+    // уже доступны читателям, а progress(прочитано байт, всего байт) решает,
+    // продолжать ли загрузку. Прерванная загрузка оставляет справочник
+    // частичным, и он не перезаписывает файл.
+    bool loadIncrementally(const std::function<bool(size_t, size_t)>& progress, size_t chunkSize = 5000);
     bool exportToFile(const std::string& filename) const;
     bool importFromFile(const std::string& filename);
     
@@ -62,4 +534,27 @@ public:
     bool isEmpty() const;
 };
 
+// Контакты справочника в заданном порядке сортировки на момент вызова
+// sortedView(). Как и ContactsView, держит снимок и не зависит от
+// дальнейших изменений. Порядок, который поддерживает PhoneBook,
+// переходит в снимок готовым, поэтому сортировка обычно не нужна.
+class SortedView {
+private:
+    const PhoneBook* book;
+    SnapshotPtr snapshot;
+    const std::vector<uint32_t>* order;     // индексы в снимке
+
+public:
+    SortedView(const PhoneBook& phoneBook, const SnapshotPtr& snap, const std::vector<uint32_t>& positions)
+        : book(&phoneBook), snapshot(snap), order(&positions) {}
+    
+    size_t size() const { return order->size(); }
+    bool empty() const { return order->empty(); }
+    
+    ContactId idAt(size_t position) const { return snapshot->getId((*order)[position]); }
+    // Текущий индекс контакта в справочнике; false - контакт уже удален
+    bool indexAt(size_t position, size_t& index) const { return book->findIndex(idAt(position), index); }
+    const Contact& operator[](size_t position) const { return snapshot->getContact((*order)[position]); }
+};
+
 #endif // PHONEBOOK_H
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include "ReadWriteLock.h"
+
+ReadWriteLock::ReadWriteLock() : activeReaders(0), waitingWriters(0), writerActive(false) {}
+
+void ReadWriteLock::lockShared() {
+    std::unique_lock<std::mutex> guard(mutex);
+    canRead.wait(guard, [this] { return !writerActive && waitingWriters == 0; });
+    activeReaders++;
+}
+
+void ReadWriteLock::unlockShared() {
+    std::unique_lock<std::mutex> guard(mutex);
+    activeReaders--;
+    if (activeReaders == 0) {
+        canWrite.notify_one();
+    }
+}
+
+void ReadWriteLock::lock() {
+    std::unique_lock<std::mutex> guard(mutex);
+    waitingWriters++;
+    canWrite.wait(guard, [this] { return !writerActive && activeReaders == 0; });
+    waitingWriters--;
+    writerActive = true;
+}
+
+void ReadWriteLock::unlock() {
+    std::unique_lock<std::mutex> guard(mutex);
+    writerActive = false;
+    if (waitingWriters > 0) {
+        canWrite.notify_one();
+    } else {
+        canRead.notify_all();
+    }
+}
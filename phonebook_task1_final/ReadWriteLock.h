@@ -0,0 +1,55 @@
+#ifndef READWRITELOCK_H
+#define READWRITELOCK_H
+
+#include <mutex>
+#include <condition_variable>
+
+// Блокировка "много читателей - один писатель".
+// Ожидающий писатель не пропускает новых читателей, чтобы поток
+// читателей не мог бесконечно откладывать запись.
+// Блокировка не рекурсивная.
+class ReadWriteLock {
+private:
+    std::mutex mutex;
+    std::condition_variable canRead;
+    std::condition_variable canWrite;
+    unsigned activeReaders;
+    unsigned waitingWriters;
+    bool writerActive;
+
+public:
+    ReadWriteLock();
+    
+    void lockShared();
+    void unlockShared();
+    void lock();
+    void unlock();
+};
+
+// Захват на чтение на время жизни объекта
+class ReadGuard {
+private:
+    ReadWriteLock& rwLock;
+
+public:
+    explicit ReadGuard(ReadWriteLock& l) : rwLock(l) { rwLock.lockShared(); }
+    ~ReadGuard() { rwLock.unlockShared(); }
+    
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+};
+
+// Захват на запись на время жизни объекта
+class WriteGuard {
+private:
+    ReadWriteLock& rwLock;
+
+public:
+    explicit WriteGuard(ReadWriteLock& l) : rwLock(l) { rwLock.lock(); }
+    ~WriteGuard() { rwLock.unlock(); }
+    
+    WriteGuard(const WriteGuard&) = delete;
+    WriteGuard& operator=(const WriteGuard&) = delete;
+};
+
+#endif // READWRITELOCK_H
@@ -0,0 +1,48 @@
+#ifndef RPCCLIENT_H
+#define RPCCLIENT_H
+
+#include <string>
+#include <vector>
+
+// Ответ сервера на одну команду: строки данных и завершающая строка
+struct RpcResponse {
+    std::vector<std::string> lines;  // "<id>\t<контакт>" или "stat\t<имя>\t<значение>"
+    std::string status;              // "ok[\t...]" или "error\t<номер>\t<причина>"
+    
+    bool ok() const { return status.compare(0, 2, "ok") == 0; }
+};
+
+// Клиент сервера справочника (RpcServer). call() - запрос с ожиданием ответа;
+// для конвейерной работы send() отправляет запросы без ожидания, а receive()
+// забирает ответы по одному в порядке отправки.
+class RpcClient {
+private:
+    int fd;
+    std::string input;
+    std::string output;
+    
+    bool readLine(std::string& line);
+
+public:
+    RpcClient();
+    ~RpcClient();
+    
+    bool connect(const std::string& socketPath);
+    void disconnect();
+    bool isConnected() const { return fd >= 0; }
+    
+    // Запрос копится в буфере; flush() отправляет накопленное
+    void send(const std::string& command);
+    bool flush();
+    bool receive(RpcResponse& response);
+    
+    bool call(const std::string& command, RpcResponse& response);
+};
+
+// Генератор нагрузки: connections соединений, в каждом requests запросов,
+// не более depth неотвеченных одновременно. Команды берутся по кругу.
+// Печатает пропускную способность и задержки; возвращает код завершения.
+int runRpcBenchmark(const std::string& socketPath, const std::vector<std::string>& commands,
+                    size_t connections, size_t requests, size_t depth);
+
+#endif // RPCCLIENT_H
@@ -0,0 +1,11 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <iostream>
+
+// Самопроверка справочника на временных файлах в текущем каталоге.
+// Для каждой проверки печатает строку "ok\t<имя>" или
+// "error\t<имя>\t<причина>"; возвращает код завершения.
+int runSelfTest(std::ostream& out = std::cout);
+
+#endif // SELFTEST_H
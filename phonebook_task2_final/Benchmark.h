@@ -0,0 +1,27 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstddef>
+#include <iostream>
+
+// Масштабирование поразрядной сортировки: одни и те же ключи (имена и
+// даты рождения в формате ключа сортировки) сортируются в 1, 2, 4, ...
+// потоках (до maxThreads, 0 - по числу ядер); печатает время и ускорение,
+// проверяет совпадение порядка. Возвращает код завершения.
+int runSortBenchmark(size_t count, unsigned maxThreads = 0, std::ostream& out = std::cout);
+
+// Пропускная способность чтения из нескольких потоков: справочник из count
+// контактов во временном файле читают 1, 2, 4, ... потоков (до maxThreads)
+// в течение seconds секунд, без писателя и с писателем, который непрерывно
+// изменяет контакты. Печатает число операций в секунду для получения
+// контакта по идентификатору, поиска и представления view().
+int runReadBenchmark(size_t count, unsigned maxThreads = 0, double seconds = 1.0,
+                     std::ostream& out = std::cout);
+
+// Стоимость чтения полей контакта: геттеры возвращают ссылки, и обход
+// rounds раз по count контактам сравнивается с тем же обходом, где каждое
+// поле копируется в строку (как при возврате по значению). Печатает время
+// на контакт и сколько выделений памяти на контакт сделали бы копии.
+int runAccessorBenchmark(size_t count, size_t rounds = 20, std::ostream& out = std::cout);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,13 @@
+#include "BookLoader.h"
+
+BookLoader::BookLoader(PhoneBook& book, const std::atomic<bool>& cancelled)
+    : QObject(nullptr), phoneBook(book), cancelFlag(cancelled) {}
+
+void BookLoader::load() {
+    bool ok = phoneBook.loadIncrementally([this](size_t bytesRead, size_t totalBytes) {
+        if (cancelFlag.load()) return false;
+        emit progress(bytesRead, totalBytes);
+        return true;
+    });
+    emit finished(ok);
+}
@@ -0,0 +1,25 @@
+#ifndef BOOKLOADER_H
+#define BOOKLOADER_H
+
+#include <QObject>
+#include <atomic>
+#include "PhoneBook.h"
+
+// Загрузка файла справочника в отдельном потоке. После каждой прочитанной
+// части сообщает о прогрессе, чтобы окно могло показать первые строки
+// сразу; cancelled прерывает загрузку (например, при закрытии окна).
+class BookLoader : public QObject {
+    Q_OBJECT
+public:
+    BookLoader(PhoneBook& book, const std::atomic<bool>& cancelled);
+public slots:
+    void load();
+signals:
+    void progress(quint64 bytesRead, quint64 totalBytes);
+    void finished(bool ok);
+private:
+    PhoneBook& phoneBook;
+    const std::atomic<bool>& cancelFlag;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef COLLATION_H
+#define COLLATION_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Двоичный ключ сопоставления для строки в UTF-8.
+// Ключи сравниваются побайтно (как memcmp) и дают порядок:
+// без учета регистра, русский алфавит по порядку (Ё сразу после Е),
+// буквы других кириллических алфавитов - за близкой русской (і после и,
+// ґ после г), латиница перед кириллицей, латинские буквы со знаками -
+// вместе с базовой буквой (Ø среди O), цифры перед буквами. При равенстве
+// буква без знака идет раньше буквы со знаком, строчная - раньше заглавной.
+std::string makeCollationKey(const std::string& str);
+
+// Поразрядная сортировка (MSD radix sort) индексов по ключам.
+// order содержит индексы в keys; сортировка устойчивая.
+// threadCount = 0 - число потоков выбирается автоматически: большие
+// массивы (от PARALLEL_SORT_THRESHOLD элементов) сортируются параллельно.
+const size_t PARALLEL_SORT_THRESHOLD = 100000;
+void radixSortByKeys(std::vector<size_t>& order, const std::vector<const std::string*>& keys,
+                     unsigned threadCount = 0);
+
+#endif // COLLATION_H
@@ -5,7 +5,28 @@
 #include <algorithm>
 #include <set>
 
-ConsoleUI::ConsoleUI(const std::string& filename) : phoneBook(filename), running(true) {}
+#ifdef _WIN32
+#include <io.h>
+#include <cstdio>
+#else
+#include <unistd.h>
+#endif
+
+// Номер строки списка, выровненный по ширине 3, как std::setw(3)
+static void appendRow(std::string& buffer, size_t row, const std::string& text) {
+    std::string number = std::to_string(row + 1);
+    if (number.size() < 3) {
+        buffer.append(3 - number.size(), ' ');
+    }
+    buffer += number;
+    buffer += ". ";
+    buffer += text;
+    buffer += '\n';
+}
+
+ConsoleUI::ConsoleUI(const std::string& filename)
+    : phoneBook(filename), running(true), sortedDisplay(false),
+      displayField(SortField::LAST_NAME), displayOrder(SortOrder::ASCENDING) {}
 
 std::string ConsoleUI::readLine(const std::string& prompt) const {
     std::cout << prompt;
@@ -63,6 +84,14 @@ void ConsoleUI::pauseScreen() const {
     std::cin.get();
 }
 
+bool ConsoleUI::isInteractiveOutput() const {
+    #ifdef _WIN32
+        return _isatty(_fileno(stdout)) != 0;
+    #else
+        return isatty(STDOUT_FILENO) != 0;
+    #endif
+}
+
 void ConsoleUI::showMainMenu() const {
     std::cout << "\n========== ТЕЛЕФОННЫЙ СПРАВОЧНИК ==========\n";
     std::cout << "1. Показать все контакты\n";
@@ -84,17 +113,114 @@ void ConsoleUI::showContactList() const {
     }
     
     std::cout << "\n========== СПИСОК КОНТАКТОВ ==========\n";
-    auto contacts = phoneBook.getAllContacts();
-    
-    for (size_t i = 0; i < contacts.size(); ++i) {
-        std::cout << std::setw(3) << i + 1 << ". " 
-                  << contacts[i].toShortString() << std::endl;
+    if (sortedDisplay) {
+        // Упорядочиваются только выводимые строки: страница при листании,
+        // весь список - при выводе в файл или канал
+        SortSpec spec(1, SortCriterion(displayField, displayOrder));
+        size_t count = phoneBook.getContactCount();
+        size_t chunk = isInteractiveOutput() ? PAGE_SIZE : count;
+        std::vector<size_t> page;
+        size_t pageStart = 0;
+        showPaged(count, [&](size_t row) {
+            if (row < pageStart || row - pageStart >= page.size()) {
+                pageStart = row;
+                page = phoneBook.getPage(spec, row, chunk);
+            }
+            ContactHandle contact;
+            if (row - pageStart < page.size()) {
+                contact = phoneBook.getContact(page[row - pageStart]);
+            }
+            return contact ? contact->toShortString() : std::string();
+        });
+    } else {
+        ContactsView contacts = phoneBook.view();
+        showPaged(contacts.size(), [&contacts](size_t row) { return contacts[row].toShortString(); });
     }
     std::cout << "=====================================\n";
 }
 
+void ConsoleUI::showPaged(size_t count, const std::function<std::string(size_t)>& rowText) const {
+    // При выводе в файл или канал листать некому - выводим все сразу
+    if (!isInteractiveOutput()) {
+        dumpRows(count, rowText);
+        return;
+    }
+    
+    size_t pages = (count + PAGE_SIZE - 1) / PAGE_SIZE;
+    size_t page = 0;
+    std::string buffer;
+    while (true) {
+        // Страница собирается в один буфер и выводится одной записью
+        buffer.clear();
+        size_t end = std::min(count, (page + 1) * PAGE_SIZE);
+        for (size_t row = page * PAGE_SIZE; row < end; ++row) {
+            appendRow(buffer, row, rowText(row));
+        }
+        if (pages > 1) {
+            buffer += "--- Страница " + std::to_string(page + 1) + " из " + std::to_string(pages) + " ---\n";
+        }
+        std::cout << buffer << std::flush;
+        if (pages <= 1) {
+            return;
+        }
+        
+        std::string answer = readLine("Enter - далее, p - назад, номер страницы, q - закончить: ");
+        if (answer == "q" || answer == "Q") {
+            return;
+        }
+        if (answer.empty() || answer == "n") {
+            if (page + 1 >= pages) {
+                return;
+            }
+            ++page;
+        } else if (answer == "p") {
+            if (page > 0) {
+                --page;
+            }
+        } else {
+            try {
+                size_t requested = std::stoul(answer);
+                if (requested >= 1 && requested <= pages) {
+                    page = requested - 1;
+                }
+            } catch (...) {
+                std::cout << "Неверный ввод.\n";
+            }
+        }
+    }
+}
+
+void ConsoleUI::dumpRows(size_t count, const std::function<std::string(size_t)>& rowText) const {
+    // Вывод блоками по 64 КБ без сброса потока на каждой строке
+    const size_t BLOCK_SIZE = 64 * 1024;
+    std::string buffer;
+    buffer.reserve(BLOCK_SIZE + 256);
+    for (size_t row = 0; row < count; ++row) {
+        appendRow(buffer, row, rowText(row));
+        if (buffer.size() >= BLOCK_SIZE) {
+            std::cout.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    std::cout.write(buffer.data(), buffer.size());
+    std::cout.flush();
+}
+
+bool ConsoleUI::rowToIndex(size_t row, size_t& index) const {
+    if (!sortedDisplay) {
+        index = row;
+        return true;
+    }
+    std::vector<size_t> page = phoneBook.getPage(SortSpec(1, SortCriterion(displayField, displayOrder)), row, 1);
+    if (page.empty()) {
+        return false;
+    }
+    index = page[0];
+    return true;
+}
+
 void ConsoleUI::showContact(size_t index) const {
-    const Contact* contact = phoneBook.getContact(index);
+    ContactHandle contact = phoneBook.getContact(index);
     if (contact) {
         std::cout << "\n========== ИНФОРМАЦИЯ О КОНТАКТЕ ==========\n";
         std::cout << contact->toString();
@@ -270,10 +396,10 @@ void ConsoleUI::editContactField(Contact& contact) {
             break;
         }
         case 7: {
-            auto phones = contact.getPhoneNumbers();
+            const auto& phones = contact.getPhoneNumbers();
             std::cout << "Текущие телефоны:\n";
             for (size_t i = 0; i < phones.size(); ++i) {
-                std::cout << i + 1 << ". " << phones[i].number << "\n";
+                std::cout << i + 1 << ". " << phones[i].number() << "\n";
             }
             
             std::cout << "1. Добавить телефон\n";
@@ -311,9 +437,11 @@ void ConsoleUI::editContactMenu() {
     }
     
     showContactList();
-    int index = readInt("Введите номер контакта для редактирования: ", 1, phoneBook.getContactCount()) - 1;
-    
-    Contact* contact = phoneBook.getContact(index);
+    size_t index = 0;
+    ContactHandle contact;
+    if (rowToIndex(readInt("Введите номер контакта для редактирования: ", 1, phoneBook.getContactCount()) - 1, index)) {
+        contact = phoneBook.getContact(index);
+    }
     if (!contact) {
         std::cout << "Контакт не найден.\n";
         return;
@@ -344,8 +472,20 @@ void ConsoleUI::deleteContactMenu() {
         return;
     }
     
+    std::cout << "1. Удалить один контакт\n";
+    std::cout << "2. Удалить все контакты, найденные по запросу\n";
+    
+    if (readInt("Выбор: ", 1, 2) == 2) {
+        deleteFoundContacts();
+        return;
+    }
+    
     showContactList();
-    int index = readInt("Введите номер контакта для удаления: ", 1, phoneBook.getContactCount()) - 1;
+    size_t index = 0;
+    if (!rowToIndex(readInt("Введите номер контакта для удаления: ", 1, phoneBook.getContactCount()) - 1, index)) {
+        std::cout << "Контакт не найден.\n";
+        return;
+    }
     
     showContact(index);
     
@@ -358,6 +498,34 @@ void ConsoleUI::deleteContactMenu() {
     }
 }
 
+void ConsoleUI::deleteFoundContacts() {
+    std::string query = readLine("Введите запрос: ");
+    std::vector<size_t> results = phoneBook.searchMultiField(query);
+    
+    if (results.empty()) {
+        std::cout << "Контакты не найдены.\n";
+        return;
+    }
+    
+    ContactSelection found = phoneBook.select(results);
+    for (size_t i = 0; i < found.size(); ++i) {
+        std::cout << std::setw(3) << i + 1 << ". " << found[i].toShortString() << "\n";
+    }
+    
+    if (confirm("Удалить найденные контакты (" + std::to_string(found.size()) + ")?")) {
+        std::vector<ContactId> idsToRemove;
+        for (size_t index : results) {
+            idsToRemove.push_back(phoneBook.getId(index));
+        }
+        size_t removed = phoneBook.removeMany(idsToRemove);
+        if (removed == 0) {
+            std::cout << "Ошибка при удалении контактов.\n";
+        } else {
+            std::cout << "Удалено контактов: " << removed << "\n";
+        }
+    }
+}
+
 void ConsoleUI::searchMenu() {
     if (phoneBook.isEmpty()) {
         std::cout << "\nСправочник пуст.\n";
@@ -394,11 +562,13 @@ void ConsoleUI::searchMenu() {
         std::cout << "Контакты не найдены.\n";
     } else {
         std::cout << "\nНайдено контактов: " << results.size() << "\n";
-        auto contacts = phoneBook.getAllContacts();
+        ContactSelection found = phoneBook.select(results);
         
-        for (size_t i = 0; i < results.size(); ++i) {
-            std::cout << "\n--- Результат " << i + 1 << " ---\n";
-            std::cout << contacts[results[i]].toString();
+        // Краткий список постранично, подробности - по номеру
+        showPaged(found.size(), [&found](size_t row) { return found[row].toShortString(); });
+        if (confirm("Показать подробную информацию о контакте?")) {
+            size_t row = readInt("Введите номер контакта: ", 1, static_cast<int>(found.size())) - 1;
+            showContact(found.indexAt(row));
         }
     }
 }
@@ -432,7 +602,10 @@ void ConsoleUI::sortMenu() {
     
     SortOrder order = (orderChoice == 1) ? SortOrder::ASCENDING : SortOrder::DESCENDING;
     
-    phoneBook.sortContacts(field, order);
+    // Меняется только порядок отображения, файл не перезаписывается
+    sortedDisplay = true;
+    displayField = field;
+    displayOrder = order;
     std::cout << "Контакты отсортированы.\n";
     
     showContactList();
@@ -480,8 +653,12 @@ void ConsoleUI::run() {
                 showContactList();
                 if (!phoneBook.isEmpty()) {
                     if (confirm("Показать подробную информацию о контакте?")) {
-                        int index = readInt("Введите номер контакта: ", 1, phoneBook.getContactCount()) - 1;
-                        showContact(index);
+                        size_t index = 0;
+                        if (rowToIndex(readInt("Введите номер контакта: ", 1, phoneBook.getContactCount()) - 1, index)) {
+                            showContact(index);
+                        } else {
+                            std::cout << "Контакт не найден.\n";
+                        }
                     }
                 }
                 pauseScreen();
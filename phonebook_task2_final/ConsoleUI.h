@@ -3,26 +3,39 @@
 
 #include "PhoneBook.h"
 #include <string>
+#include <functional>
 
 class ConsoleUI {
 private:
     PhoneBook phoneBook;
     bool running;
     
+    static const size_t PAGE_SIZE = 20;
+    
+    // Порядок отображения списка (сам справочник не переставляется)
+    bool sortedDisplay;
+    SortField displayField;
+    SortOrder displayOrder;
+    
     // Вспомогательные методы для ввода
     std::string readLine(const std::string& prompt) const;
     int readInt(const std::string& prompt, int min = 0, int max = 100) const;
     bool confirm(const std::string& question) const;
     void clearScreen() const;
     void pauseScreen() const;
+    bool isInteractiveOutput() const;
     
     // Методы меню
     void showMainMenu() const;
     void showContactList() const;
+    void showPaged(size_t count, const std::function<std::string(size_t)>& rowText) const;
+    void dumpRows(size_t count, const std::function<std::string(size_t)>& rowText) const;
     void showContact(size_t index) const;
+    bool rowToIndex(size_t row, size_t& index) const;
     void addContactMenu();
     void editContactMenu();
     void deleteContactMenu();
+    void deleteFoundContacts();
     void searchMenu();
     void sortMenu();
     void importExportMenu();
@@ -31,7 +44,7 @@ private:
     Contact inputContact(bool fullInput = true) const;
     PhoneType selectPhoneType() const;
     void editContactField(Contact& contact);
-    
+
 public:
     ConsoleUI(const std::string& filename = "phonebook.txt");
     void run();
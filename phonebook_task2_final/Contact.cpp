@@ -1,6 +1,161 @@
 #include "Contact.h"
 #include <iomanip>
 #include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+// Количество десятичных цифр кода страны (1-3)
+static size_t countryCodeLength(uint16_t code) {
+    return code >= 100 ? 3 : (code >= 10 ? 2 : 1);
+}
+
+static const uint64_t POWERS_OF_TEN[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL
+};
+
+// Реализация методов структуры PhoneNumber
+PhoneNumber::PhoneNumber(const std::string& num, PhoneType t)
+    : packed(0), countryCode(0), type(t) {
+    // Упаковывается только вид "+<код страны 1-3 цифры><10 цифр>", который
+    // number() восстанавливает в точности; все остальное хранится строкой
+    size_t length = num.length();
+    bool packable = length >= 12 && length <= 14 && num[0] == '+' && num[1] != '0';
+    for (size_t i = 1; packable && i < length; ++i) {
+        packable = num[i] >= '0' && num[i] <= '9';
+    }
+    if (!packable) {
+        text = num.empty() ? nullptr : new std::string(num);
+        return;
+    }
+    
+    size_t split = length - 10;
+    uint64_t code = 0;
+    for (size_t i = 1; i < split; ++i) {
+        code = code * 10 + static_cast<uint64_t>(num[i] - '0');
+    }
+    for (size_t i = split; i < length; ++i) {
+        packed = packed * 10 + static_cast<uint64_t>(num[i] - '0');
+    }
+    countryCode = static_cast<uint16_t>(code);
+}
+
+PhoneNumber::PhoneNumber(const PhoneNumber& other)
+    : packed(0), countryCode(other.countryCode), type(other.type) {
+    if (isPacked()) {
+        packed = other.packed;
+    } else {
+        text = other.text ? new std::string(*other.text) : nullptr;
+    }
+}
+
+PhoneNumber::PhoneNumber(PhoneNumber&& other) noexcept
+    : packed(0), countryCode(other.countryCode), type(other.type) {
+    if (isPacked()) {
+        packed = other.packed;
+    } else {
+        text = other.text;
+        other.text = nullptr;
+    }
+}
+
+PhoneNumber& PhoneNumber::operator=(const PhoneNumber& other) {
+    if (this != &other) {
+        *this = PhoneNumber(other);
+    }
+    return *this;
+}
+
+PhoneNumber& PhoneNumber::operator=(PhoneNumber&& other) noexcept {
+    if (this != &other) {
+        release();
+        countryCode = other.countryCode;
+        type = other.type;
+        if (isPacked()) {
+            packed = other.packed;
+        } else {
+            text = other.text;
+            other.text = nullptr;
+        }
+    }
+    return *this;
+}
+
+void PhoneNumber::release() {
+    if (!isPacked()) {
+        delete text;
+        text = nullptr;
+    }
+}
+
+const std::string& PhoneNumber::raw() const {
+    static const std::string empty;
+    return !isPacked() && text ? *text : empty;
+}
+
+std::string PhoneNumber::number() const {
+    if (!isPacked()) {
+        return raw();
+    }
+    // "+" + до 3 цифр кода страны + 10 цифр номера
+    char buffer[20];
+    std::snprintf(buffer, sizeof(buffer), "+%u%010llu",
+                  static_cast<unsigned>(countryCode),
+                  static_cast<unsigned long long>(packed));
+    return buffer;
+}
+
+PhoneQuery::PhoneQuery(const std::string& query)
+    : text(query), kind(ANY), value(0), length(0) {
+    if (query.empty()) {
+        return;
+    }
+    size_t start = query[0] == '+' ? 1 : 0;
+    kind = start == 1 ? PREFIX : DIGITS;
+    // В упакованном номере "+" и не больше 13 цифр
+    if (query.length() - start > 13) {
+        kind = NONE;
+        return;
+    }
+    for (size_t i = start; i < query.length(); ++i) {
+        if (query[i] < '0' || query[i] > '9') {
+            kind = NONE;
+            return;
+        }
+        value = value * 10 + static_cast<uint64_t>(query[i] - '0');
+    }
+    length = query.length() - start;
+}
+
+bool PhoneQuery::matches(const PhoneNumber& phone) const {
+    if (!phone.isPacked()) {
+        return phone.raw().find(text) != std::string::npos;
+    }
+    if (kind == ANY) {
+        return true;
+    }
+    if (kind == NONE) {
+        return false;
+    }
+    
+    // Цифры номера одним числом: код страны, затем 10 цифр с ведущими нулями
+    size_t total = countryCodeLength(phone.countryCode) + 10;
+    if (length > total) {
+        return false;
+    }
+    uint64_t all = phone.countryCode * POWERS_OF_TEN[10] + phone.digits();
+    if (kind == PREFIX) {
+        return all / POWERS_OF_TEN[total - length] == value;
+    }
+    for (size_t shift = 0; shift + length <= total; ++shift) {
+        if ((all / POWERS_OF_TEN[shift]) % POWERS_OF_TEN[length] == value) {
+            return true;
+        }
+    }
+    return false;
+}
 
 // Реализация методов структуры Date
 std::string Date::toString() const {
@@ -12,7 +167,8 @@ std::string Date::toString() const {
 }
 
 bool Date::fromString(const std::string& str) {
-    std::regex dateRegex(R"((\d{1,2})\.(\d{1,2})\.(\d{4}))");
+    // Выражения компилируются один раз: сборка std::regex дороже самой проверки
+    static const std::regex dateRegex(R"((\d{1,2})\.(\d{1,2})\.(\d{4}))");
     std::smatch match;
     
     if (std::regex_match(str, match, dateRegex)) {
@@ -57,7 +213,7 @@ bool Date::isValid() const {
 }
 
 // Реализация методов класса Contact
-Contact::Contact() : firstName(""), lastName(""), patronymic(""), address(""), email("") {}
+Contact::Contact() : firstNameKey(makeCollationKey("")), lastNameKey(makeCollationKey("")) {}
 
 Contact::Contact(const std::string& fName, const std::string& lName, 
                  const std::string& mail, const std::string& phone) {
@@ -91,44 +247,41 @@ bool Contact::validateName(const std::string& name) {
     // Проверка что имя не начинается и не заканчивается на дефис
     if (trimmedName[0] == '-' || trimmedName[trimmedName.length() - 1] == '-') return false;
     
-    // Проверка что первый символ - буква (латинская или кириллица)
-    unsigned char firstChar = static_cast<unsigned char>(trimmedName[0]);
-    
-    // Проверяем, что первый символ - это буква
-    // Для ASCII
-    if (firstChar < 128) {
-        if (!std::isalpha(firstChar)) {
+    // Быстрый путь: имя целиком из ASCII, декодирование UTF-8 не нужно
+    if (isAsciiOnly(trimmedName)) {
+        if (!std::isalpha(static_cast<unsigned char>(trimmedName[0]))) {
             return false;
         }
-    } else {
-        // Для UTF-8 кириллицы (первый байт русской буквы в UTF-8)
-        // Русские буквы в UTF-8 начинаются с 0xD0 или 0xD1
-        if (firstChar != 0xD0 && firstChar != 0xD1) {
-            return false;
+        for (char ch : trimmedName) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            if (!std::isalnum(c) && c != ' ' && c != '-') {
+                return false;
+            }
         }
+        return true;
     }
     
-    // Проверка допустимых символов в имени
+    // Общий путь: последовательно декодируем кодовые точки
     size_t i = 0;
+    bool first = true;
     while (i < trimmedName.length()) {
-        unsigned char c = static_cast<unsigned char>(trimmedName[i]);
+        unsigned int cp = 0;
+        if (!decodeUtf8(trimmedName, i, cp)) {
+            return false;
+        }
         
-        if (c < 128) {
-            // ASCII символ - проверяем, что это буква, цифра, пробел или дефис
-            if (!std::isalnum(c) && c != ' ' && c != '-') {
+        // Первый символ - обязательно буква (латиница или кириллица)
+        if (first) {
+            if (!isNameLetter(cp)) {
                 return false;
             }
-            i++;
-        } else if (c == 0xD0 || c == 0xD1) {
-            // Начало русской буквы в UTF-8
-            // Проверяем, что есть следующий байт
-            if (i + 1 >= trimmedName.length()) {
-                return false;
-            }
-            // Пропускаем два байта (русская буква в UTF-8)
-            i += 2;
-        } else {
-            // Недопустимый символ
+            first = false;
+            continue;
+        }
+        
+        // Остальные символы - буквы, цифры, пробел или дефис
+        bool isDigit = cp >= '0' && cp <= '9';
+        if (!isNameLetter(cp) && !isDigit && cp != ' ' && cp != '-') {
             return false;
         }
     }
@@ -136,17 +289,93 @@ bool Contact::validateName(const std::string& name) {
     return true;
 }
 
+bool Contact::isAsciiOnly(const std::string& str) {
+    const char* data = str.data();
+    size_t length = str.length();
+    size_t i = 0;
+    
+    // Проверяем по 8 байт за раз: старший бит любого байта означает не-ASCII
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t chunk;
+        std::memcpy(&chunk, data + i, sizeof(chunk));
+        if (chunk & 0x8080808080808080ULL) return false;
+    }
+    
+    for (; i < length; ++i) {
+        if (static_cast<unsigned char>(data[i]) & 0x80) return false;
+    }
+    
+    return true;
+}
+
+bool Contact::decodeUtf8(const std::string& str, size_t& pos, unsigned int& codePoint) {
+    unsigned char lead = static_cast<unsigned char>(str[pos]);
+    size_t length;
+    unsigned int minValue;
+    
+    if (lead < 0x80) {
+        codePoint = lead;
+        pos += 1;
+        return true;
+    } else if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        minValue = 0x80;
+        codePoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        minValue = 0x800;
+        codePoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        minValue = 0x10000;
+        codePoint = lead & 0x07;
+    } else {
+        // Продолжающий байт или недопустимый ведущий байт
+        return false;
+    }
+    
+    if (pos + length > str.length()) return false;
+    
+    for (size_t k = 1; k < length; ++k) {
+        unsigned char c = static_cast<unsigned char>(str[pos + k]);
+        if ((c & 0xC0) != 0x80) return false;
+        codePoint = (codePoint << 6) | (c & 0x3F);
+    }
+    
+    // Отсекаем избыточные (overlong) формы, суррогаты и значения вне Unicode
+    if (codePoint < minValue) return false;
+    if (codePoint >= 0xD800 && codePoint <= 0xDFFF) return false;
+    if (codePoint > 0x10FFFF) return false;
+    
+    pos += length;
+    return true;
+}
+
+bool Contact::isNameLetter(unsigned int cp) {
+    // Базовая латиница
+    if ((cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z')) return true;
+    // Latin-1 Supplement (кроме знаков умножения и деления)
+    if (cp >= 0x00C0 && cp <= 0x00FF) return cp != 0x00D7 && cp != 0x00F7;
+    // Latin Extended-A и Latin Extended-B
+    if (cp >= 0x0100 && cp <= 0x024F) return true;
+    // Кириллица и дополнительная кириллица (кроме исторических знаков)
+    if (cp >= 0x0400 && cp <= 0x052F) return cp < 0x0482 || cp > 0x0489;
+    // Latin Extended Additional
+    if (cp >= 0x1E00 && cp <= 0x1EFF) return true;
+    return false;
+}
+
 bool Contact::validateEmail(const std::string& email) {
     std::string trimmedEmail = trim(email);
     
     // Регулярное выражение для email
-    std::regex emailRegex(R"(^[a-zA-Z0-9]+@[a-zA-Z0-9]+(\.[a-zA-Z0-9]+)*$)");
+    static const std::regex emailRegex(R"(^[a-zA-Z0-9]+@[a-zA-Z0-9]+(\.[a-zA-Z0-9]+)*$)");
     return std::regex_match(trimmedEmail, emailRegex);
 }
 
 bool Contact::validatePhone(const std::string& phone) {
     // Регулярные выражения для разных форматов телефона
-    std::vector<std::regex> phoneRegexes = {
+    static const std::vector<std::regex> phoneRegexes = {
         std::regex(R"(^\+7\d{10}$)"),                    // +78121234567
         std::regex(R"(^8\d{10}$)"),                      // 88121234567
         std::regex(R"(^\+7\(\d{3}\)\d{7}$)"),           // +7(812)1234567
@@ -189,6 +418,7 @@ bool Contact::setFirstName(const std::string& name) {
     std::string trimmedName = trim(name);
     if (validateName(trimmedName)) {
         firstName = trimmedName;
+        firstNameKey = makeCollationKey(trimmedName);
         return true;
     }
     return false;
@@ -198,6 +428,7 @@ bool Contact::setLastName(const std::string& name) {
     std::string trimmedName = trim(name);
     if (validateName(trimmedName)) {
         lastName = trimmedName;
+        lastNameKey = makeCollationKey(trimmedName);
         return true;
     }
     return false;
@@ -274,7 +505,7 @@ std::string Contact::serialize() const {
     
     oss << phoneNumbers.size() << "|";
     for (const auto& phone : phoneNumbers) {
-        oss << phone.number << "," << static_cast<int>(phone.type) << "|";
+        oss << phone.number() << "," << static_cast<int>(phone.type) << "|";
     }
     
     return oss.str();
@@ -293,6 +524,8 @@ bool Contact::deserialize(const std::string& data) {
     
     firstName = tokens[0];
     lastName = tokens[1];
+    firstNameKey = makeCollationKey(tokens[0]);
+    lastNameKey = makeCollationKey(tokens[1]);
     patronymic = tokens[2];
     address = tokens[3];
     birthDate.fromString(tokens[4]);
@@ -338,7 +571,7 @@ std::string Contact::toString() const {
             case PhoneType::SERVICE: oss << "[Служебный] "; break;
             case PhoneType::OTHER: oss << "[Другой] "; break;
         }
-        oss << phone.number << "\n";
+        oss << phone.number() << "\n";
     }
     
     return oss.str();
@@ -350,7 +583,7 @@ std::string Contact::toShortString() const {
     if (!patronymic.empty()) oss << " " << patronymic;
     oss << " | " << email;
     if (!phoneNumbers.empty()) {
-        oss << " | " << phoneNumbers[0].number;
+        oss << " | " << phoneNumbers[0].number();
     }
     return oss.str();
 }
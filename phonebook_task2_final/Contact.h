@@ -8,20 +8,94 @@
 #include <regex>
 #include <ctime>
 #include <algorithm>
+#include <cstdint>
+#include <functional>
+#include "StringPool.h"
+#include "Collation.h"
 
-enum class PhoneType {
+enum class PhoneType : uint8_t {
     WORK,
     HOME,
     SERVICE,
     OTHER
 };
 
+// Телефон в упакованном виде: код страны и 10 цифр номера хранятся
+// целыми числами, строка "+7XXXXXXXXXX" формируется только при выводе.
+// Номер другого вида (например, вписанный в файл вручную) упаковать без
+// потерь нельзя - он хранится как есть в отдельной строке на месте цифр,
+// а countryCode равен 0. Упакованный номер занимает 16 байт без кучи.
 struct PhoneNumber {
-    std::string number;
+private:
+    union {
+        uint64_t packed;    // национальный номер (10 цифр)
+        std::string* text;  // номер, который нельзя упаковать; nullptr - пустой
+    };
+    
+    void release();
+
+public:
+    uint16_t countryCode;  // код страны (7 для России), 0 - номер хранится строкой
     PhoneType type;
     
-    PhoneNumber(const std::string& num = "", PhoneType t = PhoneType::OTHER) 
-        : number(num), type(t) {}
+    PhoneNumber(const std::string& num = "", PhoneType t = PhoneType::OTHER);
+    PhoneNumber(const PhoneNumber& other);
+    PhoneNumber(PhoneNumber&& other) noexcept;
+    ~PhoneNumber() { release(); }
+    PhoneNumber& operator=(const PhoneNumber& other);
+    PhoneNumber& operator=(PhoneNumber&& other) noexcept;
+    
+    bool isPacked() const { return countryCode != 0; }
+    uint64_t digits() const { return isPacked() ? packed : 0; }
+    const std::string& raw() const;  // пусто для упакованных номеров
+    std::string number() const;
+    
+    bool operator==(const PhoneNumber& other) const {
+        return countryCode == other.countryCode && digits() == other.digits() && raw() == other.raw();
+    }
+    bool operator!=(const PhoneNumber& other) const { return !(*this == other); }
+    bool operator<(const PhoneNumber& other) const {
+        if (countryCode != other.countryCode) return countryCode < other.countryCode;
+        if (digits() != other.digits()) return digits() < other.digits();
+        return raw() < other.raw();
+    }
+};
+
+static_assert(sizeof(PhoneNumber) <= 16, "упакованный телефон должен занимать не больше 16 байт");
+
+namespace std {
+    template <>
+    struct hash<PhoneNumber> {
+        size_t operator()(const PhoneNumber& phone) const {
+            if (!phone.isPacked()) {
+                return hash<string>()(phone.raw());
+            }
+            return hash<uint64_t>()(phone.digits() * 1000 + phone.countryCode);
+        }
+    };
+}
+
+// Запрос поиска по телефону, разобранный один раз. Совпадение - вхождение
+// запроса в строку number(), но упакованные номера проверяются целочисленно,
+// без сборки строки для каждого телефона.
+class PhoneQuery {
+private:
+    enum Kind {
+        ANY,      // пустой запрос
+        PREFIX,   // "+" и цифры - начало номера
+        DIGITS,   // только цифры - в любом месте номера
+        NONE      // другие символы в упакованном номере не встречаются
+    };
+    
+    std::string text;
+    Kind kind;
+    uint64_t value;   // цифры запроса
+    size_t length;    // их количество
+
+public:
+    explicit PhoneQuery(const std::string& query);
+    
+    bool matches(const PhoneNumber& phone) const;
 };
 
 struct Date {
@@ -40,34 +114,48 @@ struct Date {
 
 class Contact {
 private:
-    std::string firstName;
+    // Часто повторяющиеся поля хранятся в общем пуле строк
+    InternedString firstName;
     std::string lastName;
-    std::string patronymic;
-    std::string address;
+    InternedString patronymic;
     Date birthDate;
-    std::string email;
     std::vector<PhoneNumber> phoneNumbers;
     
+    // Адрес совпадает у членов семьи и сотрудников одной организации и
+    // хранится в пуле целиком; email у каждого свой, общий домен короткий
+    // и помещается во внутренний буфер строки, так что пул его не сократит
+    std::string email;
+    InternedString address;
+    
+    // Ключи сопоставления для сортировки по имени и фамилии
+    std::string firstNameKey;
+    std::string lastNameKey;
+    
     // Вспомогательные методы для валидации
     static std::string trim(const std::string& str);
     static bool validateName(const std::string& name);
+    static bool isAsciiOnly(const std::string& str);
+    static bool decodeUtf8(const std::string& str, size_t& pos, unsigned int& codePoint);
+    static bool isNameLetter(unsigned int codePoint);
     static bool validateEmail(const std::string& email);
     static bool validatePhone(const std::string& phone);
     static std::string normalizePhone(const std::string& phone);
-    
+
 public:
     Contact();
     Contact(const std::string& fName, const std::string& lName, 
             const std::string& mail, const std::string& phone);
     
-    // Геттеры
-    std::string getFirstName() const { return firstName; }
-    std::string getLastName() const { return lastName; }
-    std::string getPatronymic() const { return patronymic; }
-    std::string getAddress() const { return address; }
-    Date getBirthDate() const { return birthDate; }
-    std::string getEmail() const { return email; }
-    std::vector<PhoneNumber> getPhoneNumbers() const { return phoneNumbers; }
+    // Геттеры (возвращают ссылки, без копирования строк и вектора телефонов)
+    const std::string& getFirstName() const { return firstName.str(); }
+    const std::string& getLastName() const { return lastName; }
+    const std::string& getPatronymic() const { return patronymic.str(); }
+    const Date& getBirthDate() const { return birthDate; }
+    const std::string& getAddress() const { return address.str(); }
+    const std::string& getEmail() const { return email; }
+    const std::vector<PhoneNumber>& getPhoneNumbers() const { return phoneNumbers; }
+    const std::string& getFirstNameKey() const { return firstNameKey; }
+    const std::string& getLastNameKey() const { return lastNameKey; }
     
     // Сеттеры с валидацией
     bool setFirstName(const std::string& name);
@@ -0,0 +1,286 @@
+#include "ContactListModel.h"
+#include <algorithm>
+#include <unordered_set>
+
+ContactListModel::ContactListModel(PhoneBook& book, QObject* parent)
+    : QAbstractListModel(parent), phoneBook(book), mode(BOOK_ORDER), selectionShown(false),
+      sortField(SortField::LAST_NAME), sortOrder(SortOrder::ASCENDING), rowsVersion(0) {
+    rebuildRows();
+    // Обработчик подписки вызывается в потоке, изменившем справочник;
+    // соединение по умолчанию вызывает applyChanges() сразу, если это поток
+    // модели, и через очередь событий - если другой
+    qRegisterMetaType<std::vector<ChangeEvent> >("std::vector<ChangeEvent>");
+    connect(this, &ContactListModel::changesArrived, this, &ContactListModel::applyChanges);
+    subscription = phoneBook.subscribe([this](const std::vector<ChangeEvent>& events) {
+        emit changesArrived(events);
+    });
+}
+
+ContactListModel::~ContactListModel() {
+    phoneBook.unsubscribe(subscription);
+}
+
+int ContactListModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return static_cast<int>(rows.size());
+}
+
+QVariant ContactListModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= static_cast<int>(rows.size())) return QVariant();
+    ContactId id = rows[index.row()];
+    if (role == ContactIdRole) {
+        return QVariant::fromValue<qulonglong>(id.toKey());
+    }
+    if (role == Qt::DisplayRole) {
+        ContactHandle contact = phoneBook.getContact(id);
+        if (!contact) return QVariant();
+        return QString::fromStdString(contact->toShortString());
+    }
+    return QVariant();
+}
+
+bool ContactListModel::canFetchMore(const QModelIndex& parent) const {
+    if (parent.isValid() || mode != SORTED || selectionShown) return false;
+    return rows.size() < phoneBook.getContactCount();
+}
+
+void ContactListModel::fetchMore(const QModelIndex& parent) {
+    if (!canFetchMore(parent)) return;
+    std::vector<ContactId> page = sortedPage(rows.size(), FETCH_SIZE);
+    if (page.empty()) return;
+    int first = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(page.size()) - 1);
+    rows.insert(rows.end(), page.begin(), page.end());
+    endInsertRows();
+}
+
+ContactId ContactListModel::idAt(int row) const {
+    if (row < 0 || row >= static_cast<int>(rows.size())) return ContactId();
+    return rows[row];
+}
+
+int ContactListModel::rowOf(ContactId id) const {
+    auto it = std::find(rows.begin(), rows.end(), id);
+    return it == rows.end() ? -1 : static_cast<int>(it - rows.begin());
+}
+
+std::vector<ContactId> ContactListModel::sortedPage(size_t offset, size_t limit) const {
+    // Фоновая загрузка только дописывает контакты в конец, поэтому
+    // индексы страницы не сдвигаются до getId()
+    std::vector<ContactId> ids;
+    for (size_t index : phoneBook.getPage(SortSpec(1, SortCriterion(sortField, sortOrder)), offset, limit)) {
+        ids.push_back(phoneBook.getId(index));
+    }
+    return ids;
+}
+
+// Строка контакта среди первых count строк порядка сортировки;
+// -1 - контакт дальше, его покажет подгрузка
+int ContactListModel::sortedRowOf(ContactId id, size_t count) const {
+    std::vector<ContactId> page = sortedPage(0, count);
+    auto it = std::find(page.begin(), page.end(), id);
+    return it == page.end() ? -1 : static_cast<int>(it - page.begin());
+}
+
+void ContactListModel::rebuildRows() {
+    // Снимок дает идентификаторы и версию разом: события из очереди,
+    // которые уже отражены в новых строках, applyChanges() пропустит
+    SnapshotPtr current = phoneBook.snapshot();
+    rowsVersion = current->getVersion();
+    if (selectionShown) {
+        // Из выборки убираем контакты, которых больше нет в справочнике
+        rows.erase(std::remove_if(rows.begin(), rows.end(),
+            [this](ContactId id) { return phoneBook.getContact(id) == nullptr; }), rows.end());
+        return;
+    }
+    rows.clear();
+    if (mode == SORTED) {
+        // Первая страница; остальные подгружает fetchMore()
+        rows = sortedPage(0, FETCH_SIZE);
+        return;
+    }
+    size_t count = current->getContactCount();
+    rows.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        rows.push_back(current->getId(i));
+    }
+}
+
+void ContactListModel::showBookOrder() {
+    beginResetModel();
+    mode = BOOK_ORDER;
+    selectionShown = false;
+    rebuildRows();
+    endResetModel();
+}
+
+void ContactListModel::showSorted(SortField field, SortOrder order) {
+    beginResetModel();
+    mode = SORTED;
+    selectionShown = false;
+    sortField = field;
+    sortOrder = order;
+    rebuildRows();
+    endResetModel();
+}
+
+void ContactListModel::showSelection(const std::vector<ContactId>& ids) {
+    beginResetModel();
+    selectionShown = true;
+    rows = ids;
+    endResetModel();
+}
+
+void ContactListModel::appendToSelection(const std::vector<ContactId>& ids) {
+    if (!selectionShown || ids.empty()) return;
+    int first = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(ids.size()) - 1);
+    rows.insert(rows.end(), ids.begin(), ids.end());
+    endInsertRows();
+}
+
+void ContactListModel::clearSelection() {
+    if (!selectionShown) return;
+    beginResetModel();
+    selectionShown = false;
+    rebuildRows();
+    endResetModel();
+}
+
+void ContactListModel::reload() {
+    beginResetModel();
+    rebuildRows();
+    endResetModel();
+}
+
+void ContactListModel::applyChanges(const std::vector<ChangeEvent>& delivered) {
+    // Событие из очереди могло устареть: список уже перестроен по более
+    // новой версии справочника
+    std::vector<ChangeEvent> events;
+    for (const auto& event : delivered) {
+        if (event.version >= rowsVersion) {
+            events.push_back(event);
+        }
+    }
+    // Перестановка и перечитывание меняют весь список
+    for (const auto& event : events) {
+        if (event.kind == ChangeEvent::REORDERED || event.kind == ChangeEvent::RELOADED) {
+            reload();
+            return;
+        }
+    }
+    removeRows(events);
+    if (selectionShown) {
+        // Новые контакты в результаты поиска не попадают
+        refreshRows(events);
+        return;
+    }
+    if (mode == SORTED) {
+        size_t moved = 0;
+        for (const auto& event : events) {
+            if (event.kind == ChangeEvent::ADDED || event.kind == ChangeEvent::UPDATED) {
+                moved++;
+            }
+        }
+        // Одиночное изменение переставляет строку, пакет (импорт, транзакция)
+        // проще показать заново с первой страницы
+        if (moved > 1) {
+            reload();
+            return;
+        }
+        for (const auto& event : events) {
+            if (event.kind == ChangeEvent::ADDED || event.kind == ChangeEvent::UPDATED) {
+                placeSorted(event.id);
+            }
+        }
+        return;
+    }
+    // Новые контакты всегда дописываются в конец справочника, в порядке событий
+    std::vector<ContactId> added;
+    for (const auto& event : events) {
+        if (event.kind == ChangeEvent::ADDED) {
+            added.push_back(event.id);
+        }
+    }
+    if (!added.empty()) {
+        int first = static_cast<int>(rows.size());
+        beginInsertRows(QModelIndex(), first, first + static_cast<int>(added.size()) - 1);
+        rows.insert(rows.end(), added.begin(), added.end());
+        endInsertRows();
+    }
+    refreshRows(events);
+}
+
+// Убирает строки удаленных контактов; подряд идущие - одним сигналом
+void ContactListModel::removeRows(const std::vector<ChangeEvent>& events) {
+    std::unordered_set<uint64_t> removed;
+    for (const auto& event : events) {
+        if (event.kind == ChangeEvent::REMOVED) {
+            removed.insert(event.id.toKey());
+        }
+    }
+    if (removed.empty()) return;
+    int row = static_cast<int>(rows.size()) - 1;
+    while (row >= 0) {
+        if (!removed.count(rows[row].toKey())) {
+            --row;
+            continue;
+        }
+        int last = row;
+        while (row > 0 && removed.count(rows[row - 1].toKey())) {
+            --row;
+        }
+        beginRemoveRows(QModelIndex(), row, last);
+        rows.erase(rows.begin() + row, rows.begin() + last + 1);
+        endRemoveRows();
+        --row;
+    }
+}
+
+// Перерисовывает строки измененных контактов
+void ContactListModel::refreshRows(const std::vector<ChangeEvent>& events) {
+    std::unordered_set<uint64_t> updated;
+    for (const auto& event : events) {
+        if (event.kind == ChangeEvent::UPDATED) {
+            updated.insert(event.id.toKey());
+        }
+    }
+    if (updated.empty()) return;
+    for (size_t row = 0; row < rows.size(); ++row) {
+        if (updated.count(rows[row].toKey())) {
+            QModelIndex changed = index(static_cast<int>(row));
+            emit dataChanged(changed, changed);
+        }
+    }
+}
+
+// Ставит добавленный или измененный контакт на его место в порядке
+// сортировки. Загруженные строки остаются началом этого порядка: контакт
+// может переехать за них или, наоборот, в них
+void ContactListModel::placeSorted(ContactId id) {
+    int row = rowOf(id);
+    int newRow = sortedRowOf(id, row < 0 ? rows.size() + 1 : rows.size());
+    if (row < 0 && newRow >= 0) {
+        beginInsertRows(QModelIndex(), newRow, newRow);
+        rows.insert(rows.begin() + newRow, id);
+        endInsertRows();
+        return;
+    }
+    if (row >= 0 && newRow < 0) {
+        beginRemoveRows(QModelIndex(), row, row);
+        rows.erase(rows.begin() + row);
+        endRemoveRows();
+        return;
+    }
+    if (row < 0) return;
+    if (newRow != row) {
+        // Строка переезжает на новое место в порядке сортировки
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), newRow > row ? newRow + 1 : newRow);
+        rows.erase(rows.begin() + row);
+        rows.insert(rows.begin() + newRow, id);
+        endMoveRows();
+        row = newRow;
+    }
+    QModelIndex changed = index(row);
+    emit dataChanged(changed, changed);
+}
@@ -0,0 +1,67 @@
+#ifndef CONTACTLISTMODEL_H
+#define CONTACTLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <vector>
+#include "PhoneBook.h"
+
+// Модель списка контактов поверх PhoneBook для QListView.
+// Хранит только идентификаторы строк; текст строки строится в data()
+// по запросу представления, то есть лишь для видимых строк. В режиме
+// сортировки строки подгружаются страницами getPage() по мере прокрутки
+// (fetchMore), поэтому весь справочник не сортируется.
+// Модель подписана на изменения справочника (PhoneBook::subscribe) и по
+// событиям обновляет конкретные строки, откуда бы ни пришло изменение.
+// События из потока интерфейса применяются сразу, из фоновой загрузки -
+// через очередь событий Qt; изменять справочник после загрузки можно
+// только из потока интерфейса. Контакты читаются через getContact() как
+// ContactHandle, поэтому строка удаленного контакта до своего события
+// просто пуста.
+class ContactListModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+    enum Roles {
+        ContactIdRole = Qt::UserRole  // ContactId::toKey()
+    };
+    explicit ContactListModel(PhoneBook& book, QObject* parent = nullptr);
+    ~ContactListModel();  // справочник должен пережить модель
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+    ContactId idAt(int row) const;
+    int rowOf(ContactId id) const;
+    // Режимы отображения; каждый полностью перестраивает список
+    void showBookOrder();
+    void showSorted(SortField field, SortOrder order);
+    void showSelection(const std::vector<ContactId>& ids);
+    void appendToSelection(const std::vector<ContactId>& ids);  // дописывает строки без сброса
+    void clearSelection();
+signals:
+    void changesArrived(const std::vector<ChangeEvent>& events);
+private slots:
+    void applyChanges(const std::vector<ChangeEvent>& events);
+private:
+    enum Mode {
+        BOOK_ORDER,
+        SORTED
+    };
+    static const size_t FETCH_SIZE = 200;  // строк в одной подгрузке
+    PhoneBook& phoneBook;
+    Mode mode;
+    bool selectionShown;  // показана выборка поверх режима mode
+    SortField sortField;
+    SortOrder sortOrder;
+    std::vector<ContactId> rows;
+    uint64_t rowsVersion;  // версия справочника, по которой строки перестроены
+    size_t subscription;
+    void reload();
+    void rebuildRows();
+    void removeRows(const std::vector<ChangeEvent>& events);
+    void refreshRows(const std::vector<ChangeEvent>& events);
+    void placeSorted(ContactId id);
+    std::vector<ContactId> sortedPage(size_t offset, size_t limit) const;
+    int sortedRowOf(ContactId id, size_t count) const;
+};
+
+#endif
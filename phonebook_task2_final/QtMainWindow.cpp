@@ -1,15 +1,22 @@
 #include "QtMainWindow.h"
 #include <QApplication>
+#include <QStatusBar>
 
 QtMainWindow::QtMainWindow(const std::string& filename, QWidget* parent)
-    : QMainWindow(parent), phoneBook(filename) {
+    : QMainWindow(parent), phoneBook(filename, false), searchGeneration(0), loadCancelled(false) {
     QWidget* central = new QWidget(this);
     setCentralWidget(central);
-    listWidget = new QListWidget(central);
+    listModel = new ContactListModel(phoneBook, this);
+    listView = new QListView(central);
+    // Одинаковая высота строк позволяет не измерять каждую строку
+    listView->setUniformItemSizes(true);
+    listView->setModel(listModel);
     addButton = new QPushButton(QString::fromUtf8("Добавить"), central);
     editButton = new QPushButton(QString::fromUtf8("Редактировать"), central);
     deleteButton = new QPushButton(QString::fromUtf8("Удалить"), central);
-    searchButton = new QPushButton(QString::fromUtf8("Поиск"), central);
+    searchEdit = new QLineEdit(central);
+    searchEdit->setPlaceholderText(QString::fromUtf8("Поиск"));
+    searchEdit->setClearButtonEnabled(true);
     sortButton = new QPushButton(QString::fromUtf8("Сортировать"), central);
     importButton = new QPushButton(QString::fromUtf8("Импорт"), central);
     exportButton = new QPushButton(QString::fromUtf8("Экспорт"), central);
@@ -18,35 +25,97 @@ QtMainWindow::QtMainWindow(const std::string& filename, QWidget* parent)
     buttonsTop->addWidget(editButton);
     buttonsTop->addWidget(deleteButton);
     QHBoxLayout* buttonsBottom = new QHBoxLayout();
-    buttonsBottom->addWidget(searchButton);
     buttonsBottom->addWidget(sortButton);
     buttonsBottom->addWidget(importButton);
     buttonsBottom->addWidget(exportButton);
     QVBoxLayout* mainLayout = new QVBoxLayout(central);
     mainLayout->addLayout(buttonsTop);
-    mainLayout->addWidget(listWidget);
+    mainLayout->addWidget(searchEdit);
+    mainLayout->addWidget(listView);
     mainLayout->addLayout(buttonsBottom);
     connect(addButton, &QPushButton::clicked, this, &QtMainWindow::addContact);
     connect(editButton, &QPushButton::clicked, this, &QtMainWindow::editSelectedContact);
     connect(deleteButton, &QPushButton::clicked, this, &QtMainWindow::deleteSelectedContact);
-    connect(searchButton, &QPushButton::clicked, this, &QtMainWindow::searchContacts);
     connect(sortButton, &QPushButton::clicked, this, &QtMainWindow::sortContacts);
     connect(importButton, &QPushButton::clicked, this, &QtMainWindow::importFromFile);
     connect(exportButton, &QPushButton::clicked, this, &QtMainWindow::exportToFile);
-    refreshList();
+    // Запрос уходит, когда пользователь перестал печатать на SEARCH_DELAY_MS
+    const int SEARCH_DELAY_MS = 150;
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(SEARCH_DELAY_MS);
+    connect(searchEdit, &QLineEdit::textChanged, searchTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(searchTimer, &QTimer::timeout, this, &QtMainWindow::startSearch);
+    qRegisterMetaType<QVector<qulonglong> >("QVector<qulonglong>");
+    searchThread = new QThread(this);
+    SearchWorker* worker = new SearchWorker(phoneBook, searchGeneration);
+    worker->moveToThread(searchThread);
+    connect(searchThread, &QThread::finished, worker, &QObject::deleteLater);
+    connect(this, &QtMainWindow::searchRequested, worker, &SearchWorker::search);
+    connect(worker, &SearchWorker::resultsReady, this, &QtMainWindow::showSearchResults);
+    searchThread->start();
+    // Файл читается в фоне: окно появляется сразу, строки - по мере загрузки
+    loadProgress = new QProgressBar(this);
+    loadProgress->setRange(0, 100);
+    statusBar()->addPermanentWidget(loadProgress);
+    statusBar()->showMessage(QString::fromUtf8("Загрузка справочника..."));
+    setEditingEnabled(false);
+    loaderThread = new QThread(this);
+    BookLoader* loader = new BookLoader(phoneBook, loadCancelled);
+    loader->moveToThread(loaderThread);
+    connect(loaderThread, &QThread::started, loader, &BookLoader::load);
+    connect(loaderThread, &QThread::finished, loader, &QObject::deleteLater);
+    connect(loader, &BookLoader::progress, this, &QtMainWindow::showLoadProgress);
+    connect(loader, &BookLoader::finished, this, &QtMainWindow::finishLoading);
+    loaderThread->start();
 }
 
-void QtMainWindow::refreshList() {
-    listWidget->clear();
-    auto contacts = phoneBook.getAllContacts();
-    for (const auto& c : contacts) {
-        listWidget->addItem(QString::fromStdString(c.toShortString()));
+QtMainWindow::~QtMainWindow() {
+    // Прерываем загрузку и поиск и дожидаемся потоков до разрушения справочника
+    loadCancelled = true;
+    ++searchGeneration;
+    loaderThread->quit();
+    loaderThread->wait();
+    searchThread->quit();
+    searchThread->wait();
+    // Дочерние объекты удаляются уже после справочника, а модель
+    // подписана на его изменения
+    listView->setModel(nullptr);
+    delete listModel;
+}
+
+void QtMainWindow::setEditingEnabled(bool enabled) {
+    addButton->setEnabled(enabled);
+    editButton->setEnabled(enabled);
+    deleteButton->setEnabled(enabled);
+    searchEdit->setEnabled(enabled);
+    sortButton->setEnabled(enabled);
+    importButton->setEnabled(enabled);
+    exportButton->setEnabled(enabled);
+}
+
+void QtMainWindow::showLoadProgress(quint64 bytesRead, quint64 totalBytes) {
+    loadProgress->setValue(totalBytes == 0 ? 100 : static_cast<int>(bytesRead * 100 / totalBytes));
+}
+
+void QtMainWindow::finishLoading(bool ok) {
+    statusBar()->removeWidget(loadProgress);
+    loadProgress->deleteLater();
+    statusBar()->clearMessage();
+    if (!ok) {
+        // Частично загруженный справочник не перезапишет файл, но и менять его нельзя
+        QMessageBox::warning(this, QString::fromUtf8("Ошибка"), QString::fromUtf8("Не удалось загрузить справочник"));
+        return;
     }
+    // Поиск идет в отдельном потоке по снимкам справочника
+    phoneBook.enableSnapshots();
+    setEditingEnabled(true);
 }
 
-int QtMainWindow::selectedIndex() const {
-    auto item = listWidget->currentRow();
-    return item;
+ContactId QtMainWindow::selectedId() const {
+    QModelIndex current = listView->currentIndex();
+    if (!current.isValid()) return ContactId();
+    return listModel->idAt(current.row());
 }
 
 Contact QtMainWindow::inputContact(Contact initial, bool fullInput) {
@@ -66,7 +135,7 @@ Contact QtMainWindow::inputContact(Contact initial, bool fullInput) {
     }
     QString phone = QInputDialog::getText(this, QString::fromUtf8("Телефон"), QString::fromUtf8("Телефон:"), QLineEdit::Normal, ok ? "" : "", &ok);
     if (!initial.getPhoneNumbers().empty()) {
-        phone = QString::fromStdString(initial.getPhoneNumbers()[0].number);
+        phone = QString::fromStdString(initial.getPhoneNumbers()[0].number());
     }
     if (!ok || phone.isEmpty()) {
         throw std::runtime_error("invalid");
@@ -102,10 +171,11 @@ Contact QtMainWindow::inputContact(Contact initial, bool fullInput) {
 void QtMainWindow::addContact() {
     try {
         Contact c = inputContact(Contact(), true);
-        if (phoneBook.addContact(c)) {
-            refreshList();
-        } else {
+        if (!phoneBook.addContact(c)) {
             QMessageBox::warning(this, QString::fromUtf8("Ошибка"), QString::fromUtf8("Не удалось добавить контакт"));
+        } else {
+            // Нового контакта нет в результатах поиска - возвращаемся к полному списку
+            listModel->clearSelection();
         }
     } catch (...) {
         QMessageBox::warning(this, QString::fromUtf8("Ошибка"), QString::fromUtf8("Неверные данные"));
@@ -113,15 +183,12 @@ void QtMainWindow::addContact() {
 }
 
 void QtMainWindow::editSelectedContact() {
-    int idx = selectedIndex();
-    if (idx < 0 || idx >= static_cast<int>(phoneBook.getContactCount())) return;
-    const Contact* current = phoneBook.getContact(idx);
+    ContactId id = selectedId();
+    ContactHandle current = phoneBook.getContact(id);
     if (!current) return;
     try {
         Contact edited = inputContact(*current, true);
-        if (phoneBook.updateContact(idx, edited)) {
-            refreshList();
-        } else {
+        if (!phoneBook.updateContact(id, edited)) {
             QMessageBox::warning(this, QString::fromUtf8("Ошибка"), QString::fromUtf8("Не удалось обновить контакт"));
         }
     } catch (...) {
@@ -130,27 +197,35 @@ void QtMainWindow::editSelectedContact() {
 }
 
 void QtMainWindow::deleteSelectedContact() {
-    int idx = selectedIndex();
-    if (idx < 0 || idx >= static_cast<int>(phoneBook.getContactCount())) return;
+    ContactId id = selectedId();
+    if (!phoneBook.getContact(id)) return;
     if (QMessageBox::question(this, QString::fromUtf8("Подтверждение"), QString::fromUtf8("Удалить выбранный контакт?")) == QMessageBox::Yes) {
-        if (phoneBook.removeContact(idx)) {
-            refreshList();
-        } else {
+        if (!phoneBook.removeContact(id)) {
             QMessageBox::warning(this, QString::fromUtf8("Ошибка"), QString::fromUtf8("Не удалось удалить контакт"));
         }
     }
 }
 
-void QtMainWindow::searchContacts() {
-    bool ok = false;
-    QString query = QInputDialog::getText(this, QString::fromUtf8("Поиск"), QString::fromUtf8("Запрос:"), QLineEdit::Normal, "", &ok);
-    if (!ok) return;
-    auto idxs = phoneBook.searchMultiField(query.toStdString());
-    listWidget->clear();
-    auto all = phoneBook.getAllContacts();
-    for (auto i : idxs) {
-        listWidget->addItem(QString::fromStdString(all[i].toShortString()));
+void QtMainWindow::startSearch() {
+    quint64 generation = ++searchGeneration;
+    QString query = searchEdit->text();
+    if (query.isEmpty()) {
+        listModel->clearSelection();
+        return;
+    }
+    // Результаты приходят частями и дописываются в пустую выборку
+    listModel->showSelection(std::vector<ContactId>());
+    emit searchRequested(generation, query);
+}
+
+void QtMainWindow::showSearchResults(quint64 generation, const QVector<qulonglong>& ids) {
+    if (generation != searchGeneration.load()) return;
+    std::vector<ContactId> found;
+    found.reserve(ids.size());
+    for (qulonglong key : ids) {
+        found.push_back(ContactId::fromKey(key));
     }
+    listModel->appendToSelection(found);
 }
 
 void QtMainWindow::sortContacts() {
@@ -168,15 +243,13 @@ void QtMainWindow::sortContacts() {
     else if (field == QString::fromUtf8("Email")) f = SortField::EMAIL;
     else if (field == QString::fromUtf8("Дата рождения")) f = SortField::BIRTH_DATE;
     SortOrder o = (order == QString::fromUtf8("По возрастанию")) ? SortOrder::ASCENDING : SortOrder::DESCENDING;
-    phoneBook.sortContacts(f, o);
-    refreshList();
+    listModel->showSorted(f, o);
 }
 
 void QtMainWindow::importFromFile() {
     QString path = QFileDialog::getOpenFileName(this, QString::fromUtf8("Импорт из файла"));
     if (path.isEmpty()) return;
     if (phoneBook.importFromFile(path.toStdString())) {
-        refreshList();
         QMessageBox::information(this, QString::fromUtf8("Импорт"), QString::fromUtf8("Данные импортированы"));
     } else {
         QMessageBox::warning(this, QString::fromUtf8("Ошибка"), QString::fromUtf8("Не удалось импортировать"));
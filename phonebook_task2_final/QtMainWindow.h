@@ -2,7 +2,7 @@
 #define QTMAINWINDOW_H
 
 #include <QMainWindow>
-#include <QListWidget>
+#include <QListView>
 #include <QPushButton>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
@@ -10,32 +10,53 @@
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QLineEdit>
+#include <QTimer>
+#include <QThread>
+#include <QProgressBar>
+#include <atomic>
 #include "PhoneBook.h"
+#include "ContactListModel.h"
+#include "SearchWorker.h"
+#include "BookLoader.h"
 
 class QtMainWindow : public QMainWindow {
     Q_OBJECT
 public:
     explicit QtMainWindow(const std::string& filename = "phonebook.txt", QWidget* parent = nullptr);
+    ~QtMainWindow();
+signals:
+    void searchRequested(quint64 generation, const QString& query);
 private slots:
-    void refreshList();
     void addContact();
     void editSelectedContact();
     void deleteSelectedContact();
-    void searchContacts();
+    void startSearch();
+    void showSearchResults(quint64 generation, const QVector<qulonglong>& ids);
+    void showLoadProgress(quint64 bytesRead, quint64 totalBytes);
+    void finishLoading(bool ok);
     void sortContacts();
     void importFromFile();
     void exportToFile();
 private:
     PhoneBook phoneBook;
-    QListWidget* listWidget;
+    ContactListModel* listModel;
+    QListView* listView;
     QPushButton* addButton;
     QPushButton* editButton;
     QPushButton* deleteButton;
-    QPushButton* searchButton;
+    QLineEdit* searchEdit;
+    QTimer* searchTimer;
+    QThread* searchThread;
+    std::atomic<quint64> searchGeneration;  // номер последнего запроса; старые прерываются
+    QProgressBar* loadProgress;
+    QThread* loaderThread;
+    std::atomic<bool> loadCancelled;
     QPushButton* sortButton;
     QPushButton* importButton;
     QPushButton* exportButton;
-    int selectedIndex() const;
+    ContactId selectedId() const;
+    void setEditingEnabled(bool enabled);
     Contact inputContact(Contact initial = Contact(), bool fullInput = true);
 };
 
@@ -0,0 +1,211 @@
+#include "RpcClient.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#endif
+
+// Строка завершает ответ, если это "ok[\t...]" или "error\t..."
+static bool isStatusLine(const std::string& line) {
+    return line == "ok" || line.compare(0, 3, "ok\t") == 0 || line.compare(0, 6, "error\t") == 0;
+}
+
+RpcClient::RpcClient() : fd(-1) {}
+
+RpcClient::~RpcClient() {
+    disconnect();
+}
+
+#ifndef _WIN32
+
+bool RpcClient::connect(const std::string& socketPath) {
+    disconnect();
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+void RpcClient::disconnect() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    input.clear();
+    output.clear();
+}
+
+bool RpcClient::flush() {
+    size_t sent = 0;
+    while (sent < output.size()) {
+        ssize_t written = ::send(fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            disconnect();
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    output.clear();
+    return true;
+}
+
+bool RpcClient::readLine(std::string& line) {
+    size_t end;
+    while ((end = input.find('\n')) == std::string::npos) {
+        char buffer[64 * 1024];
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            disconnect();
+            return false;
+        }
+        input.append(buffer, static_cast<size_t>(received));
+    }
+    line.assign(input, 0, end);
+    input.erase(0, end + 1);
+    return true;
+}
+
+#else
+
+bool RpcClient::connect(const std::string&) { return false; }
+void RpcClient::disconnect() {}
+bool RpcClient::flush() { return false; }
+bool RpcClient::readLine(std::string&) { return false; }
+
+#endif
+
+void RpcClient::send(const std::string& command) {
+    output += command;
+    output += '\n';
+}
+
+bool RpcClient::receive(RpcResponse& response) {
+    // Отправленные, но не сброшенные запросы иначе ждали бы ответа вечно
+    if (!output.empty() && !flush()) {
+        return false;
+    }
+    response.lines.clear();
+    response.status.clear();
+    std::string line;
+    while (readLine(line)) {
+        if (isStatusLine(line)) {
+            response.status = line;
+            return true;
+        }
+        response.lines.push_back(line);
+    }
+    return false;
+}
+
+bool RpcClient::call(const std::string& command, RpcResponse& response) {
+    send(command);
+    return receive(response);
+}
+
+int runRpcBenchmark(const std::string& socketPath, const std::vector<std::string>& commands,
+                    size_t connections, size_t requests, size_t depth) {
+    typedef std::chrono::steady_clock Clock;
+    if (commands.empty() || connections == 0 || requests == 0) {
+        std::cerr << "Нечего отправлять" << std::endl;
+        return 1;
+    }
+    depth = std::max<size_t>(depth, 1);
+    
+    std::mutex resultsMutex;
+    std::vector<double> latencies;   // микросекунды
+    size_t failures = 0;
+    size_t errors = 0;
+    latencies.reserve(connections * requests);
+    
+    auto worker = [&]() {
+        RpcClient client;
+        std::vector<double> local;
+        local.reserve(requests);
+        size_t localErrors = 0;
+        bool failed = !client.connect(socketPath);
+        
+        std::deque<Clock::time_point> sentAt;
+        size_t sent = 0;
+        RpcResponse response;
+        while (!failed && local.size() < requests) {
+            // Окно неотвеченных запросов заполняется одной записью в сокет
+            while (sent < requests && sentAt.size() < depth) {
+                client.send(commands[sent % commands.size()]);
+                sentAt.push_back(Clock::now());
+                ++sent;
+            }
+            if (!client.receive(response)) {
+                failed = true;
+                break;
+            }
+            local.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sentAt.front()).count());
+            sentAt.pop_front();
+            if (!response.ok()) {
+                ++localErrors;
+            }
+        }
+        
+        std::lock_guard<std::mutex> guard(resultsMutex);
+        latencies.insert(latencies.end(), local.begin(), local.end());
+        errors += localErrors;
+        if (failed) {
+            ++failures;
+        }
+    };
+    
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < connections; ++i) {
+        threads.push_back(std::thread(worker));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    
+    if (latencies.empty()) {
+        std::cerr << "Не удалось подключиться к " << socketPath << std::endl;
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    std::cout << "requests\t" << latencies.size() << '\n'
+              << "errors\t" << errors << '\n'
+              << "failed_connections\t" << failures << '\n'
+              << "seconds\t" << seconds << '\n'
+              << "requests_per_second\t" << latencies.size() / seconds << '\n'
+              << "latency_p50_us\t" << percentile(0.50) << '\n'
+              << "latency_p99_us\t" << percentile(0.99) << '\n'
+              << "latency_max_us\t" << latencies.back() << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+#include "RpcServer.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <cstring>
+
+// Флаг остановки устанавливается обработчиком сигнала
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+
+RpcServer::RpcServer(PhoneBook& book, const std::string& path)
+    : phoneBook(book), socketPath(path), cli(book, output), listenFd(-1), epollFd(-1) {
+    // Клиент сокета не должен читать и писать файлы сервера
+    cli.setFileCommandsEnabled(false);
+}
+
+RpcServer::~RpcServer() {
+    shutdown();
+}
+
+#ifdef __linux__
+
+bool RpcServer::listenSocket() {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Слишком длинный путь к сокету: " << socketPath << std::endl;
+        return false;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || !setNonBlocking(listenFd)) {
+        std::cerr << "Не удалось создать сокет: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    // Сокет от прошлого запуска мешает bind(); если на нем кто-то слушает,
+    // connect() пройдет, и второй сервер не запускается
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        bool busy = connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        close(probe);
+        if (busy) {
+            // Чужой сокет не удаляем при остановке
+            close(listenFd);
+            listenFd = -1;
+            std::cerr << "Сокет " << socketPath << " уже обслуживается другим сервером" << std::endl;
+            return false;
+        }
+    }
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Не удалось открыть сокет " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        std::cerr << "Не удалось создать epoll: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+}
+
+void RpcServer::acceptConnections() {
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            // EAGAIN - очередь подключений пуста
+            return;
+        }
+        if (!setNonBlocking(fd)) {
+            close(fd);
+            continue;
+        }
+        Connection& connection = connections[fd];
+        connection.requests = 0;
+        connection.closing = false;
+        connection.reading = true;
+        connection.writing = false;
+        
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            connections.erase(fd);
+            close(fd);
+        }
+    }
+}
+
+void RpcServer::readRequests(int fd, Connection& connection) {
+    char buffer[64 * 1024];
+    while (connection.output.size() < MAX_PENDING_OUTPUT) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received == 0) {
+            // Последняя строка без перевода строки тоже считается запросом
+            if (!connection.input.empty()) {
+                connection.input += '\n';
+            }
+            connection.closing = true;
+            connection.reading = false;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            connection.input.clear();
+            connection.output.clear();
+            connection.closing = true;
+            connection.reading = false;
+        }
+        break;
+    }
+    processRequests(connection);
+}
+
+void RpcServer::processRequests(Connection& connection) {
+    // Выполняем все полные строки; хвост ждет следующего чтения
+    size_t start = 0;
+    size_t end;
+    while ((end = connection.input.find('\n', start)) != std::string::npos) {
+        cli.runLine(++connection.requests, connection.input.substr(start, end - start));
+        start = end + 1;
+    }
+    connection.input.erase(0, start);
+    // Ответы этого клиента забираются до того, как придут запросы следующего
+    cli.flush();
+    if (connection.input.size() > MAX_REQUEST_LINE) {
+        output << "error\t" << connection.requests + 1 << "\tслишком длинный запрос" << '\n';
+        connection.input.clear();
+        connection.closing = true;
+        connection.reading = false;
+    }
+    connection.output += output.str();
+    output.str(std::string());
+}
+
+bool RpcServer::writeResponses(int fd, Connection& connection) {
+    size_t sent = 0;
+    while (sent < connection.output.size()) {
+        ssize_t written = send(fd, connection.output.data() + sent, connection.output.size() - sent, MSG_NOSIGNAL);
+        if (written > 0) {
+            sent += static_cast<size_t>(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            // Клиент отключился, не дочитав ответы
+            return false;
+        }
+    }
+    connection.output.erase(0, sent);
+    return true;
+}
+
+void RpcServer::updateEvents(int fd, Connection& connection) {
+    bool wantRead = !connection.closing && connection.output.size() < MAX_PENDING_OUTPUT;
+    bool wantWrite = !connection.output.empty();
+    if (wantRead == connection.reading && wantWrite == connection.writing) {
+        return;
+    }
+    connection.reading = wantRead;
+    connection.writing = wantWrite;
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = (wantRead ? EPOLLIN : 0u) | (wantWrite ? EPOLLOUT : 0u);
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void RpcServer::closeConnection(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+void RpcServer::shutdown() {
+    for (const auto& entry : connections) {
+        close(entry.first);
+    }
+    connections.clear();
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+        listenFd = -1;
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+        epollFd = -1;
+    }
+}
+
+int RpcServer::run() {
+    if (!listenSocket()) {
+        shutdown();
+        return 1;
+    }
+    
+    // Сигналы остановки заблокированы везде, кроме epoll_pwait: сигнал,
+    // пришедший между проверкой флага и ожиданием, прерывает ожидание сразу.
+    // Поток записи наследует маску, так что сигнал получает только этот поток.
+    sigset_t stopSignals;
+    sigset_t waitMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &waitMask);
+    sigset_t previousMask = waitMask;
+    sigdelset(&waitMask, SIGINT);
+    sigdelset(&waitMask, SIGTERM);
+    
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    
+    // Запись файла после изменений не задерживает цикл обработки
+    phoneBook.setDeferredSaves(true);
+    std::cerr << "Справочник обслуживает " << socketPath << " (" << phoneBook.getContactCount()
+              << " контактов)" << std::endl;
+    
+    const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    while (!stopRequested) {
+        int ready = epoll_pwait(epollFd, events, MAX_EVENTS, -1, &waitMask);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Ошибка epoll: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& connection = found->second;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                readRequests(fd, connection);
+            }
+            if (!writeResponses(fd, connection) ||
+                (connection.closing && connection.output.empty())) {
+                closeConnection(fd);
+                continue;
+            }
+            // Когда ответы ушли, чтение приостановленного клиента возобновляется
+            updateEvents(fd, connection);
+        }
+    }
+    
+    cli.flush();
+    shutdown();
+    phoneBook.setDeferredSaves(false);
+    pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+    std::cerr << "Сервер остановлен" << std::endl;
+    return 0;
+}
+
+#else
+
+bool RpcServer::listenSocket() { return false; }
+void RpcServer::shutdown() {}
+
+int RpcServer::run() {
+    std::cerr << "Режим сервера поддерживается только в Linux" << std::endl;
+    return 1;
+}
+
+#endif
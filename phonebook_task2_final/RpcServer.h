@@ -0,0 +1,60 @@
+#ifndef RPCSERVER_H
+#define RPCSERVER_H
+
+#include "PhoneBook.h"
+#include "BatchCLI.h"
+#include <string>
+#include <sstream>
+#include <map>
+
+// Сервер справочника на локальном сокете (только Linux, epoll).
+// Протокол - команды BatchCLI, по одной в строке; ответ на каждую команду
+// заканчивается строкой "ok[\t...]" или "error\t<номер запроса>\t<причина>".
+// Клиент может отправлять запросы не дожидаясь ответов: все полные строки,
+// пришедшие за одно чтение, выполняются подряд, а add и remove из них
+// применяются одной транзакцией. Ответы приходят в порядке запросов.
+// Все соединения обслуживаются одним потоком, поэтому команды разных
+// клиентов не перемешиваются. Файл справочника записывается в фоне
+// (PhoneBook::setDeferredSaves); export и import на сервере отключены.
+class RpcServer {
+private:
+    struct Connection {
+        std::string input;
+        std::string output;
+        size_t requests;   // номер последнего запроса - для сообщений об ошибках
+        bool closing;      // клиент закрыл запись: дописать ответы и закрыть
+        bool reading;      // ждем ли сейчас новых данных (EPOLLIN)
+        bool writing;      // ждем ли возможности записи (EPOLLOUT)
+    };
+    
+    // Пока неотправленных ответов больше этого, запросы клиента не читаются
+    static const size_t MAX_PENDING_OUTPUT = 1024 * 1024;
+    // Строка запроса длиннее этого считается ошибкой клиента
+    static const size_t MAX_REQUEST_LINE = 64 * 1024;
+    
+    PhoneBook& phoneBook;
+    std::string socketPath;
+    std::ostringstream output;
+    BatchCLI cli;
+    std::map<int, Connection> connections;
+    int listenFd;
+    int epollFd;
+    
+    bool listenSocket();
+    void acceptConnections();
+    void readRequests(int fd, Connection& connection);
+    void processRequests(Connection& connection);
+    bool writeResponses(int fd, Connection& connection);
+    void updateEvents(int fd, Connection& connection);
+    void closeConnection(int fd);
+    void shutdown();
+
+public:
+    RpcServer(PhoneBook& book, const std::string& path);
+    ~RpcServer();
+    
+    // Обслуживает клиентов до SIGINT/SIGTERM; возвращает код завершения
+    int run();
+};
+
+#endif // RPCSERVER_H
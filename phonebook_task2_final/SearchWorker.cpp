@@ -0,0 +1,25 @@
+#include "SearchWorker.h"
+#include <algorithm>
+
+SearchWorker::SearchWorker(const PhoneBook& book, const std::atomic<quint64>& latest)
+    : QObject(nullptr), phoneBook(book), latestGeneration(latest) {}
+
+void SearchWorker::search(quint64 generation, const QString& query) {
+    // Пока запрос ждал в очереди, пользователь мог набрать следующий
+    if (generation != latestGeneration.load()) return;
+    SnapshotPtr snapshot = phoneBook.snapshot();
+    std::string text = query.toStdString();
+    size_t total = snapshot->getContactCount();
+    for (size_t from = 0; from < total; from += CHUNK_SIZE) {
+        if (generation != latestGeneration.load()) return;
+        std::vector<size_t> found = snapshot->searchMultiField(text, from, std::min(total, from + CHUNK_SIZE));
+        if (found.empty()) continue;
+        QVector<qulonglong> ids;
+        ids.reserve(static_cast<int>(found.size()));
+        for (size_t index : found) {
+            ids.push_back(snapshot->getId(index).toKey());
+        }
+        emit resultsReady(generation, ids);
+    }
+    emit searchFinished(generation);
+}
@@ -0,0 +1,29 @@
+#ifndef SEARCHWORKER_H
+#define SEARCHWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include "PhoneBook.h"
+
+// Поиск по всем полям в отдельном потоке. Работает со снимком справочника,
+// поэтому не блокирует интерфейс и его изменения. Просматривает контакты
+// частями и отдает найденное после каждой части; запрос прерывается, как
+// только latestGeneration перестает совпадать с его номером.
+class SearchWorker : public QObject {
+    Q_OBJECT
+public:
+    SearchWorker(const PhoneBook& book, const std::atomic<quint64>& latest);
+public slots:
+    void search(quint64 generation, const QString& query);
+signals:
+    void resultsReady(quint64 generation, const QVector<qulonglong>& ids);  // ContactId::toKey()
+    void searchFinished(quint64 generation);
+private:
+    static const size_t CHUNK_SIZE = 4096;
+    const PhoneBook& phoneBook;
+    const std::atomic<quint64>& latestGeneration;
+};
+
+#endif
@@ -0,0 +1,813 @@
+#include "SelfTest.h"
+#include "PhoneBook.h"
+#include "Collation.h"
+#include "StringPool.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+const char* const TEST_FILE = "phonebook_selftest.tmp";
+const char* const EXPECTED_FILE = "phonebook_selftest_expected.tmp";
+// Файл в несуществующем каталоге: любая запись справочника не удается
+const char* const UNWRITABLE_FILE = "phonebook_selftest_missing_dir/phonebook.txt";
+
+// Контакт с повторяющимися фамилией, именем и датой рождения и
+// уникальной почтой, по которой контакты различаются в проверках
+Contact makeContact(size_t number, const char* lastName) {
+    static const char* const FIRST_NAMES[] = {"Анна", "Иван", "Ольга"};
+    Contact contact(FIRST_NAMES[number % 3], lastName,
+                    "user" + std::to_string(number) + "@mail.ru", "+79990000000");
+    contact.setBirthDate(1 + static_cast<int>(number % 2), 1, 1990);
+    return contact;
+}
+
+// Пакет событий подписчика строкой: A - добавление, U - изменение,
+// R - удаление, O - перестановка, L - перечитывание
+std::string describeEvents(const std::vector<ChangeEvent>& events) {
+    static const char KINDS[] = "AUROL";
+    std::string text;
+    for (const auto& event : events) {
+        text += KINDS[event.kind];
+    }
+    return text;
+}
+
+// Строки файла справочника и число строк удаления среди них
+std::vector<std::string> readFileLines(const char* name, size_t& tombstoneLines) {
+    std::vector<std::string> lines;
+    std::ifstream file(name);
+    std::string line;
+    tombstoneLines = 0;
+    while (std::getline(file, line)) {
+        if (line.compare(0, 5, "#DEL|") == 0) {
+            tombstoneLines++;
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::string describe(const SortSpec& spec, size_t offset) {
+    static const char* const FIELDS[] = {"имя", "фамилия", "почта", "дата"};
+    std::ostringstream text;
+    for (const auto& criterion : spec) {
+        text << FIELDS[static_cast<size_t>(criterion.field)]
+             << (criterion.order == SortOrder::DESCENDING ? "↓ " : "↑ ");
+    }
+    text << "с позиции " << offset;
+    return text.str();
+}
+
+// Ключи сопоставления дают алфавитный порядок; в каждой строке таблицы
+// слова идут по возрастанию
+bool testCollationOrder(std::string& failure) {
+    static const char* const ORDERED[][3] = {
+        {"Е", "Ё", "Ж"},
+        {"Ефимов", "Ёлкин", "Жуков"},
+        {"Oa", "Øb", "Oc"},
+        {"Ostrov", "Øyvind", "Ozol"},
+        {"Strasse", "Straße", "Strasst"},
+        {"Aerts", "Æsir", "Aesop"},
+        {"Yvonne", "ÿvonne", "Yvonnf"},
+        {"Yvette", "Ÿvonne", "Zoe"}
+    };
+    for (const auto& row : ORDERED) {
+        for (size_t i = 1; i < 3; ++i) {
+            if (!(makeCollationKey(row[i - 1]) < makeCollationKey(row[i]))) {
+                failure = std::string(row[i - 1]) + " не раньше " + row[i];
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Имена из латиницы со знаками принимаются, знаки × и ÷ - нет;
+// контакт с таким именем добавляется и перечитывается из файла
+bool testNameLetters(std::string& failure) {
+    static const char* const VALID[] = {"Øyvind", "Ģirts", "Łukasz", "Ÿvonne", "Ævar", "Ёлкин-Щука"};
+    static const char* const INVALID[] = {"×", "A×B", "Ann÷a", "÷Ivan", "1Øyvind", "҂Иван"};
+    Contact contact;
+    for (const char* name : VALID) {
+        if (!contact.setFirstName(name)) {
+            failure = std::string("отклонено имя ") + name;
+            return false;
+        }
+    }
+    for (const char* name : INVALID) {
+        if (contact.setFirstName(name)) {
+            failure = std::string("принято имя ") + name;
+            return false;
+        }
+    }
+    
+    PhoneBook book(TEST_FILE, false);
+    for (size_t i = 0; i < sizeof(VALID) / sizeof(VALID[0]); ++i) {
+        Contact named = makeContact(i, "Петров");
+        named.setFirstName(VALID[i]);
+        book.addContact(named);
+    }
+    book.save();
+    PhoneBook reloaded(TEST_FILE);
+    if (reloaded.searchByName("Ÿvonne").size() != 1 || reloaded.getContactCount() != book.getContactCount()) {
+        failure = "контакты с такими именами не перечитываются";
+        return false;
+    }
+    return true;
+}
+
+// Экономия пула считается по живым строкам: перечитывание справочника
+// ее не накручивает, короткие строки в нее не входят
+bool testPoolStats(std::string& failure) {
+    const std::string LONG_NAME = "Аполлинария";
+    size_t before = StringPool::instance().getStats().bytesSaved;
+    std::vector<size_t> saved;
+    for (size_t round = 0; round < 3; ++round) {
+        std::vector<Contact> contacts;
+        for (size_t i = 0; i < 10; ++i) {
+            Contact contact = makeContact(i, "Петров");
+            contact.setFirstName(LONG_NAME);
+            contacts.push_back(contact);
+        }
+        saved.push_back(StringPool::instance().getStats().bytesSaved - before);
+    }
+    // Десять имен: девять повторов длинной строки; короткие поля не в счет
+    if (saved[0] != 9 * LONG_NAME.length() || saved[1] != saved[0] || saved[2] != saved[0]) {
+        failure = "сэкономлено " + std::to_string(saved[0]) + ", затем " + std::to_string(saved[2]) + " байт";
+        return false;
+    }
+    return true;
+}
+
+// Упакованные и неупаковываемые номера переживают копирование,
+// перемещение и перевыделение вектора без изменений
+bool testPhoneNumbers(std::string& failure) {
+    static const char* const NUMBERS[] = {"+78121234567", "+3801234567890", "12-34", "", "+712345678901234567890"};
+    std::vector<PhoneNumber> phones;
+    for (size_t round = 0; round < 20; ++round) {
+        for (const char* number : NUMBERS) {
+            phones.push_back(PhoneNumber(number, PhoneType::HOME));
+        }
+    }
+    std::vector<PhoneNumber> copies = phones;
+    PhoneNumber assigned;
+    for (size_t i = 0; i < phones.size(); ++i) {
+        const char* expected = NUMBERS[i % (sizeof(NUMBERS) / sizeof(NUMBERS[0]))];
+        assigned = copies[i];
+        PhoneNumber moved(std::move(copies[i]));
+        if (phones[i].number() != expected || moved.number() != expected || assigned != phones[i] ||
+            moved.type != PhoneType::HOME) {
+            failure = std::string("номер ") + expected + " изменился";
+            return false;
+        }
+    }
+    if (!PhoneNumber("+78121234567").isPacked() || PhoneNumber("12-34").isPacked()) {
+        failure = "неверный выбор упакованного вида";
+        return false;
+    }
+    return true;
+}
+
+// Страницы getPage() совпадают с порядком после устойчивой sortContacts(),
+// в том числе для равных ключей и для поддерживаемых порядков, которые
+// обновлялись добавлениями, удалениями и изменениями
+bool testPagesMatchSort(std::string& failure) {
+    static const char* const LAST_NAMES[] = {"Петров", "Иванов", "Сидоров"};
+    PhoneBook book(TEST_FILE, false);
+    std::vector<SortSpec> specs;
+    for (int f = 0; f < 4; ++f) {
+        specs.push_back(SortSpec(1, SortCriterion(static_cast<SortField>(f))));
+        specs.push_back(SortSpec(1, SortCriterion(static_cast<SortField>(f), SortOrder::DESCENDING)));
+        // Поддерживаемые порядки строятся до изменений
+        book.sortedView(static_cast<SortField>(f));
+        book.sortedView(static_cast<SortField>(f), SortOrder::DESCENDING);
+    }
+    SortSpec composite;
+    composite.push_back(SortCriterion(SortField::LAST_NAME));
+    composite.push_back(SortCriterion(SortField::BIRTH_DATE, SortOrder::DESCENDING));
+    specs.push_back(composite);
+    
+    for (size_t i = 0; i < 60; ++i) {
+        book.addContact(makeContact(i, LAST_NAMES[i % 3]));
+    }
+    // Освободившиеся ячейки занимают новые контакты, поэтому номера ячеек
+    // больше не совпадают с порядком справочника
+    for (size_t i = 0; i < 60; i += 7) {
+        book.removeContact(book.getId(i));
+    }
+    for (size_t i = 60; i < 70; ++i) {
+        book.addContact(makeContact(i, LAST_NAMES[i % 3]));
+    }
+    for (size_t i = 3; i < book.getContactCount(); i += 11) {
+        Contact changed = *book.getContact(i);
+        changed.setLastName(LAST_NAMES[(i + 1) % 3]);
+        book.updateContact(i, changed);
+    }
+    
+    std::vector<Contact> all = book.getAllContacts();
+    for (const auto& spec : specs) {
+        PhoneBook expected(EXPECTED_FILE, false);
+        for (const auto& contact : all) {
+            expected.addContact(contact);
+        }
+        expected.sortContacts(spec);
+        
+        for (size_t offset : {0, 5, 17, 55}) {
+            std::vector<size_t> page = book.getPage(spec, offset, 10);
+            for (size_t k = 0; k < page.size(); ++k) {
+                if (book.getContact(page[k])->getEmail() != expected.getContact(offset + k)->getEmail()) {
+                    failure = describe(spec, offset) + ": " + book.getContact(page[k])->getEmail() +
+                              " вместо " + expected.getContact(offset + k)->getEmail();
+                    return false;
+                }
+            }
+        }
+    }
+    
+    // Страница до конца справочника: offset + limit не переполняется
+    size_t rest = book.getContactCount() - 5;
+    if (book.getPage(specs[0], 5, SIZE_MAX).size() != rest ||
+        book.getPage(composite, 5, SIZE_MAX).size() != rest ||
+        book.snapshot()->getPage(SortField::EMAIL, SortOrder::ASCENDING, 5, SIZE_MAX).size() != rest) {
+        failure = "страница с limit = SIZE_MAX обрезана";
+        return false;
+    }
+    return true;
+}
+
+// Новый снимок разделяет с предыдущим неизмененные контакты, а старый
+// снимок не видит изменений; порядки снимка совпадают со справочником
+bool testSnapshotsShareContacts(std::string& failure) {
+    PhoneBook book(TEST_FILE, false);
+    book.enableSnapshots();
+    book.sortedView(SortField::LAST_NAME);
+    for (size_t i = 0; i < 50; ++i) {
+        book.addContact(makeContact(i, i % 2 ? "Петров" : "Иванов"));
+    }
+    SnapshotPtr before = book.snapshot();
+    Contact changed = *book.getContact(10);
+    changed.setLastName("Сидоров");
+    book.updateContact(10, changed);
+    book.removeContact(book.getId(20));
+    SnapshotPtr after = book.snapshot();
+    
+    if (before->getContactCount() != 50 || after->getContactCount() != 49) {
+        failure = "неверное число контактов в снимках";
+        return false;
+    }
+    if (before->getContact(10).getLastName() != "Иванов" || after->getContact(10).getLastName() != "Сидоров") {
+        failure = "изменение контакта видно в старом снимке или не видно в новом";
+        return false;
+    }
+    for (size_t i = 0; i < after->getContactCount(); ++i) {
+        size_t old = 0;
+        if (!before->findIndex(after->getId(i), old)) {
+            failure = "контакт " + std::to_string(i) + " не найден в старом снимке";
+            return false;
+        }
+        bool shared = before->getContactHandle(old) == after->getContactHandle(i);
+        if (shared != (i != 10)) {
+            failure = "контакт " + std::to_string(i) + (shared ? " не скопирован после изменения" : " скопирован без изменения");
+            return false;
+        }
+    }
+    // Справочник и снимок хранят один и тот же объект, а не копии
+    for (size_t i = 0; i < after->getContactCount(); ++i) {
+        if (book.getContact(after->getId(i)) != after->getContactHandle(i)) {
+            failure = "снимок хранит копию контакта " + std::to_string(i);
+            return false;
+        }
+    }
+    
+    for (SortField field : {SortField::LAST_NAME, SortField::FIRST_NAME}) {
+        for (SortOrder order : {SortOrder::ASCENDING, SortOrder::DESCENDING}) {
+            std::vector<size_t> expected = book.getPage(SortSpec(1, SortCriterion(field, order)), 0, 100);
+            std::vector<size_t> page = after->getPage(field, order, 0, 100);
+            if (page.size() != expected.size()) {
+                failure = "неверный размер страницы снимка";
+                return false;
+            }
+            for (size_t k = 0; k < page.size(); ++k) {
+                if (after->getId(page[k]) != book.getId(expected[k])) {
+                    failure = "порядок снимка отличается от справочника на позиции " + std::to_string(k);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Читатели в нескольких потоках работают с view(), select(), поиском,
+// getContact() и снимками, пока писатель добавляет, меняет и
+// удаляет контакты. Каждое представление должно быть согласованным:
+// без повторов, с контактами, которые существовали на момент его создания.
+bool testConcurrentReaders(std::string& failure) {
+    PhoneBook book(TEST_FILE, false);
+    PhoneBookTransaction initial = book.transaction();
+    for (size_t i = 0; i < 2000; ++i) {
+        initial.add(makeContact(i, i % 2 ? "Петров" : "Иванов"));
+    }
+    initial.commit();
+    
+    std::atomic<bool> writing(true);
+    std::atomic<size_t> errors(0);
+    auto reader = [&]() {
+        size_t round = 0;
+        while (writing.load()) {
+            ContactsView contacts = book.view();
+            std::unordered_set<uint64_t> seen;
+            for (auto it = contacts.begin(); it != contacts.end(); ++it) {
+                if (!seen.insert(it.id().toKey()).second || it->getEmail().compare(0, 4, "user") != 0) {
+                    errors++;
+                }
+            }
+            // Индексы поиска относятся к справочнику на момент поиска,
+            // поэтому select() проверяется только на согласованность
+            ContactSelection found = book.select(book.searchByName("Петров"));
+            for (size_t k = 0; k < found.size(); ++k) {
+                if (found[k].getEmail().compare(0, 4, "user") != 0 || !found.idAt(k).isValid()) {
+                    errors++;
+                }
+            }
+            SnapshotPtr snapshot = book.snapshot();
+            for (size_t index : snapshot->searchByName("Петров")) {
+                if (snapshot->getContact(index).getLastName() != "Петров") {
+                    errors++;
+                }
+            }
+            ContactHandle handle = book.getContact(book.getId(round++ % 1000));
+            if (handle && handle->getFirstName().empty()) {
+                errors++;
+            }
+        }
+    };
+    
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.push_back(std::thread(reader));
+    }
+    for (size_t i = 0; i < 300; ++i) {
+        ContactId id = book.getId(i * 5);
+        if (i % 3 == 0) {
+            book.removeContact(id);
+        } else if (i % 3 == 1) {
+            ContactHandle current = book.getContact(id);
+            if (current) {
+                Contact changed = *current;
+                changed.setLastName("Сидоров");
+                book.updateContact(id, changed);
+            }
+        } else {
+            book.addContact(makeContact(2000 + i, "Петров"));
+        }
+    }
+    writing = false;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    
+    if (errors.load() != 0) {
+        failure = "несогласованных чтений: " + std::to_string(errors.load());
+        return false;
+    }
+    if (book.view().size() != book.getContactCount() || book.getContactCount() != 2000) {
+        failure = "неверное число контактов после изменений: " + std::to_string(book.getContactCount());
+        return false;
+    }
+    return true;
+}
+
+// Несколько писателей меняют справочник, а читатели обходят sortedView()
+// и читают контакты по идентификаторам. Файл пишется после снятия
+// блокировки, поэтому в конце проверяется, что в нем последняя версия,
+// а не записанная позже более старая.
+bool testReaderWriterStress(std::string& failure) {
+    PhoneBook book(TEST_FILE, false);
+    PhoneBookTransaction initial = book.transaction();
+    for (size_t i = 0; i < 500; ++i) {
+        initial.add(makeContact(i, i % 2 ? "Петров" : "Иванов"));
+    }
+    initial.commit();
+    std::vector<ContactId> initialIds;
+    std::vector<Contact> added;
+    for (size_t i = 0; i < 500; ++i) {
+        initialIds.push_back(book.getId(i));
+        // makeContact() проверяет дату через localtime(), поэтому заранее
+        added.push_back(makeContact(10000 + i, "Сидоров"));
+    }
+    
+    std::atomic<size_t> writersLeft(2);
+    std::atomic<size_t> errors(0);
+    auto reader = [&]() {
+        while (writersLeft.load() != 0) {
+            SortedView sorted = book.sortedView(SortField::LAST_NAME);
+            std::unordered_set<uint64_t> seen;
+            for (size_t row = 0; row < sorted.size(); ++row) {
+                if (!seen.insert(sorted.idAt(row).toKey()).second ||
+                    (row > 0 && sorted[row].getLastNameKey() < sorted[row - 1].getLastNameKey())) {
+                    errors++;
+                }
+            }
+            for (size_t row = 0; row < sorted.size(); row += 37) {
+                ContactHandle contact = book.getContact(sorted.idAt(row));
+                if (contact && contact->getEmail().compare(0, 4, "user") != 0) {
+                    errors++;
+                }
+            }
+        }
+    };
+    // Каждый писатель меняет и удаляет только свою половину исходных контактов
+    auto writer = [&](size_t first) {
+        for (size_t i = 0; i < 150; ++i) {
+            book.addContact(added[first + i]);
+            ContactId id = initialIds[first + i];
+            if (i % 3 == 1) {
+                Contact changed = *book.getContact(id);
+                changed.setLastName("Смирнов");
+                book.updateContact(id, changed);
+            } else if (i % 3 == 2) {
+                book.removeContact(id);
+            }
+        }
+        writersLeft--;
+    };
+    
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+        threads.push_back(std::thread(reader));
+    }
+    threads.push_back(std::thread(writer, 0));
+    threads.push_back(std::thread(writer, 250));
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    if (errors.load() != 0) {
+        failure = "несогласованных чтений: " + std::to_string(errors.load());
+        return false;
+    }
+    if (book.getContactCount() != 700) {
+        failure = "неверное число контактов после изменений: " + std::to_string(book.getContactCount());
+        return false;
+    }
+    ContactsView contacts = book.view();
+    PhoneBook saved(TEST_FILE);
+    ContactsView inFile = saved.view();
+    if (inFile.size() != contacts.size()) {
+        failure = "в файле " + std::to_string(inFile.size()) + " контактов вместо " + std::to_string(contacts.size());
+        return false;
+    }
+    for (size_t i = 0; i < contacts.size(); ++i) {
+        if (inFile[i].serialize() != contacts[i].serialize()) {
+            failure = "контакт " + std::to_string(i) + " в файле отличается от справочника";
+            return false;
+        }
+    }
+    
+    // Представление остается прежним, а индекс удаленного контакта не находится
+    SortedView before = book.sortedView(SortField::LAST_NAME);
+    std::string firstContact = before[0].serialize();
+    book.removeContact(before.idAt(0));
+    size_t index;
+    if (before.indexAt(0, index) || before.size() != 700 || before[0].serialize() != firstContact) {
+        failure = "представление изменилось после удаления или нашло удаленный контакт";
+        return false;
+    }
+    return true;
+}
+
+// Пакет, который не удалось записать, не меняет справочник: изменения,
+// удаления и добавления откатываются, а идентификаторы остаются прежними
+bool testBatchRollback(std::string& failure) {
+    PhoneBook book(UNWRITABLE_FILE, false);
+    for (size_t i = 0; i < 20; ++i) {
+        book.addContact(makeContact(i, "Петров"));
+    }
+    std::vector<ContactId> idsBefore;
+    std::vector<std::string> before;
+    for (size_t i = 0; i < book.getContactCount(); ++i) {
+        idsBefore.push_back(book.getId(i));
+        before.push_back(book.getContact(i)->serialize());
+    }
+    
+    PhoneBookTransaction batch = book.transaction();
+    Contact changed = *book.getContact(3);
+    changed.setLastName("Сидоров");
+    batch.update(book.getId(3), changed);
+    changed.setLastName("Иванов");
+    batch.update(book.getId(3), changed);
+    batch.remove(book.getId(5));
+    batch.remove(book.getId(0));
+    batch.add(makeContact(100, "Смирнов"));
+    if (batch.commit()) {
+        failure = "пакет применен, хотя файл не записан";
+        return false;
+    }
+    
+    if (book.getContactCount() != before.size()) {
+        failure = "после отката " + std::to_string(book.getContactCount()) + " контактов";
+        return false;
+    }
+    for (size_t i = 0; i < before.size(); ++i) {
+        if (book.getId(i) != idsBefore[i] || book.getContact(i)->serialize() != before[i]) {
+            failure = "контакт " + std::to_string(i) + " изменился после отката";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testRemoveFailure(std::string& failure) {
+    PhoneBook book(UNWRITABLE_FILE, false);
+    for (size_t i = 0; i < 20; ++i) {
+        book.addContact(makeContact(i, i % 2 == 0 ? "Петров" : "Иванов"));
+    }
+    size_t removed = book.removeIf([](const Contact& contact) {
+        return contact.getLastName() == "Петров";
+    });
+    if (removed != 0) {
+        failure = "удалено " + std::to_string(removed) + " контактов, хотя файл не записан";
+        return false;
+    }
+    if (book.getContactCount() != 20 || book.searchByName("Петров").size() != 10) {
+        failure = "справочник изменился после неудачной записи";
+        return false;
+    }
+    return true;
+}
+
+bool testChangeEvents(std::string& failure) {
+    std::mutex batchesMutex;
+    std::vector<std::vector<ChangeEvent> > batches;
+    ChangeListener listener = [&batchesMutex, &batches](const std::vector<ChangeEvent>& events) {
+        std::lock_guard<std::mutex> guard(batchesMutex);
+        batches.push_back(events);
+    };
+    PhoneBook book(TEST_FILE, false);
+    for (size_t i = 0; i < 5; ++i) {
+        book.addContact(makeContact(i, "Петров"));
+    }
+    book.subscribe(listener);
+    
+    book.addContact(makeContact(10, "Петров"));
+    ContactId added = book.getId(book.getContactCount() - 1);
+    Contact changed = *book.getContact(added);
+    changed.setLastName("Сидоров");
+    book.updateContact(added, changed);
+    book.removeContact(added);
+    if (batches.size() != 3 || describeEvents(batches[0]) != "A" || describeEvents(batches[1]) != "U" ||
+        describeEvents(batches[2]) != "R") {
+        failure = "после добавления, изменения и удаления " + std::to_string(batches.size()) + " пакетов событий";
+        return false;
+    }
+    if (batches[0][0].id != added || batches[1][0].id != added || batches[2][0].id != added ||
+        batches[1][0].changedFields != ChangeEvent::LAST_NAME) {
+        failure = "события относятся не к тому контакту или полю";
+        return false;
+    }
+    // Версия события - до изменения: снимок после изменения его уже отражает
+    if (batches[0][0].version >= batches[2][0].version || batches[2][0].version >= book.snapshot()->getVersion()) {
+        failure = "версии событий не растут вместе с версией справочника";
+        return false;
+    }
+    
+    // Откаченный пакет событий не дает
+    {
+        PhoneBook unwritable(UNWRITABLE_FILE, false);
+        unwritable.addContact(makeContact(0, "Иванов"));
+        unwritable.subscribe(listener);
+        PhoneBookTransaction batch = unwritable.transaction();
+        batch.update(unwritable.getId(0), changed);
+        batch.add(makeContact(1, "Иванов"));
+        if (batch.commit() || batches.size() != 3) {
+            failure = "откаченный пакет дал события";
+            return false;
+        }
+    }
+    
+    // Примененный пакет - один пакет событий в порядке операций
+    PhoneBookTransaction batch = book.transaction();
+    batch.update(book.getId(0), changed);
+    batch.remove(book.getId(1));
+    batch.add(makeContact(11, "Петров"));
+    if (!batch.commit() || batches.size() != 4 || describeEvents(batches[3]) != "URA") {
+        failure = "пакет транзакции не доставлен одним пакетом событий";
+        return false;
+    }
+    
+    // Параллельные операции не смешивают события: по пакету на добавление
+    const size_t PER_THREAD = 50;
+    std::vector<Contact> prepared[2];
+    for (size_t t = 0; t < 2; ++t) {
+        for (size_t i = 0; i < PER_THREAD; ++i) {
+            prepared[t].push_back(makeContact(100 + t * PER_THREAD + i, "Смирнов"));
+        }
+    }
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < 2; ++t) {
+        writers.push_back(std::thread([&book, &prepared, t]() {
+            for (const auto& contact : prepared[t]) {
+                book.addContact(contact);
+            }
+        }));
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    std::unordered_set<uint64_t> addedIds;
+    for (size_t i = 4; i < batches.size(); ++i) {
+        if (describeEvents(batches[i]) != "A") {
+            failure = "пакет параллельного добавления: " + describeEvents(batches[i]);
+            return false;
+        }
+        addedIds.insert(batches[i][0].id.toKey());
+    }
+    if (addedIds.size() != 2 * PER_THREAD) {
+        failure = "доставлено " + std::to_string(addedIds.size()) + " добавлений вместо " +
+                  std::to_string(2 * PER_THREAD);
+        return false;
+    }
+    return true;
+}
+
+bool testTombstones(std::string& failure) {
+    PhoneBook book(TEST_FILE, false);
+    for (size_t i = 0; i < 10; ++i) {
+        book.addContact(makeContact(i, "Петров"));
+    }
+    // Порог выше доли удаленных: фоновое уплотнение не запускается
+    book.setTombstoneMode(true, 0.9);
+    std::unordered_set<uint64_t> removedKeys;
+    for (size_t i : {1, 4, 7}) {
+        ContactId id = book.getId(i);
+        removedKeys.insert(id.toKey());
+        book.removeContact(id);
+    }
+    if (book.getTombstoneCount() != 3 || book.getContactCount() != 7) {
+        failure = "после удаления " + std::to_string(book.getTombstoneCount()) + " надгробий";
+        return false;
+    }
+    
+    ContactsView contacts = book.view();
+    if (contacts.size() != 7) {
+        failure = "в view() " + std::to_string(contacts.size()) + " строк вместо 7";
+        return false;
+    }
+    for (auto it = contacts.begin(); it != contacts.end(); ++it) {
+        if (removedKeys.count(it.id().toKey())) {
+            failure = "view() показывает удаленный контакт";
+            return false;
+        }
+    }
+    if (book.searchByName("Петров").size() != 7) {
+        failure = "поиск находит удаленные контакты";
+        return false;
+    }
+    
+    // Файл с дописанными строками удаления читается без удаленных контактов
+    PhoneBook reloaded(TEST_FILE);
+    if (reloaded.getContactCount() != 7) {
+        failure = "после перечитывания " + std::to_string(reloaded.getContactCount()) + " контактов";
+        return false;
+    }
+    return true;
+}
+
+bool testTombstoneCompaction(std::string& failure) {
+    std::vector<ContactId> ids;
+    {
+        PhoneBook book(TEST_FILE, false);
+        for (size_t i = 0; i < 20; ++i) {
+            book.addContact(makeContact(i, "Петров"));
+        }
+        for (size_t i = 0; i < book.getContactCount(); ++i) {
+            ids.push_back(book.getId(i));
+        }
+        book.setTombstoneMode(true, 0.25);
+        
+        // Пакет и removeMany() только дописывают строки удаления
+        PhoneBookTransaction batch = book.transaction();
+        batch.remove(ids[0]);
+        batch.remove(ids[5]);
+        batch.remove(ids[10]);
+        std::vector<ContactId> more;
+        more.push_back(ids[15]);
+        more.push_back(ids[16]);
+        if (!batch.commit() || book.removeMany(more) != 2) {
+            failure = "удаления не применены";
+            return false;
+        }
+        size_t tombstoneLines;
+        size_t lineCount = readFileLines(TEST_FILE, tombstoneLines).size();
+        if (lineCount != 25 || tombstoneLines != 5 || book.getTombstoneCount() != 5) {
+            failure = "в файле " + std::to_string(lineCount) + " строк, из них удалений " +
+                      std::to_string(tombstoneLines) + " вместо 25 и 5";
+            return false;
+        }
+        
+        // Удаленные записи прошлого запуска тоже считаются надгробиями
+        {
+            PhoneBook reloaded(TEST_FILE);
+            if (reloaded.getContactCount() != 15 || reloaded.getTombstoneCount() != 5) {
+                failure = "после перечитывания " + std::to_string(reloaded.getContactCount()) +
+                          " контактов и " + std::to_string(reloaded.getTombstoneCount()) + " надгробий";
+                return false;
+            }
+        }
+        
+        // Шестое удаление превышает порог: фоновое уплотнение перезаписывает
+        // файл, деструктор дожидается его завершения
+        book.removeContact(ids[19]);
+    }
+    
+    size_t tombstoneLines;
+    size_t lineCount = readFileLines(TEST_FILE, tombstoneLines).size();
+    if (lineCount != 14 || tombstoneLines != 0) {
+        failure = "после уплотнения в файле " + std::to_string(lineCount) + " строк, из них удалений " +
+                  std::to_string(tombstoneLines);
+        return false;
+    }
+    PhoneBook reloaded(TEST_FILE);
+    if (reloaded.getContactCount() != 14 || reloaded.getTombstoneCount() != 0) {
+        failure = "после уплотнения прочитано " + std::to_string(reloaded.getContactCount()) + " контактов";
+        return false;
+    }
+    return true;
+}
+
+bool testDeferredSaves(std::string& failure) {
+    PhoneBook book(TEST_FILE, false);
+    book.setDeferredSaves(true);
+    for (size_t i = 0; i < 50; ++i) {
+        book.addContact(makeContact(i, i % 2 == 0 ? "Петров" : "Иванов"));
+    }
+    size_t removed = book.removeIf([](const Contact& contact) {
+        return contact.getLastName() == "Иванов";
+    });
+    PhoneBookTransaction batch = book.transaction();
+    batch.remove(book.getId(0));
+    batch.add(makeContact(100, "Смирнов"));
+    if (removed != 25 || !batch.commit()) {
+        failure = "изменения не применены";
+        return false;
+    }
+    // Выключение дожидается записи последнего изменения
+    book.setDeferredSaves(false);
+    
+    PhoneBook reloaded(TEST_FILE);
+    if (reloaded.getContactCount() != 25 || reloaded.searchByName("Смирнов").size() != 1) {
+        failure = "в файле " + std::to_string(reloaded.getContactCount()) + " контактов вместо 25";
+        return false;
+    }
+    return true;
+}
+
+}
+
+int runSelfTest(std::ostream& out) {
+    struct Test {
+        const char* name;
+        bool (*run)(std::string& failure);
+    };
+    const Test tests[] = {
+        {"name_letters", testNameLetters},
+        {"collation_order", testCollationOrder},
+        {"pool_stats", testPoolStats},
+        {"phone_numbers", testPhoneNumbers},
+        {"pages_match_sort", testPagesMatchSort},
+        {"snapshots_share_contacts", testSnapshotsShareContacts},
+        {"concurrent_readers", testConcurrentReaders},
+        {"reader_writer_stress", testReaderWriterStress},
+        {"batch_rollback", testBatchRollback},
+        {"remove_failure", testRemoveFailure},
+        {"change_events", testChangeEvents},
+        {"tombstones", testTombstones},
+        {"tombstone_compaction", testTombstoneCompaction},
+        {"deferred_saves", testDeferredSaves}
+    };
+    
+    bool passed = true;
+    for (const auto& test : tests) {
+        std::string failure;
+        if (test.run(failure)) {
+            out << "ok\t" << test.name << '\n';
+        } else {
+            out << "error\t" << test.name << '\t' << failure << '\n';
+            passed = false;
+        }
+        std::remove(TEST_FILE);
+        std::remove(EXPECTED_FILE);
+    }
+    out.flush();
+    return passed ? 0 : 1;
+}
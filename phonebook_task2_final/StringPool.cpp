@@ -0,0 +1,95 @@
+#include "StringPool.h"
+#include <tuple>
+
+InternedString::InternedString(const std::string& str)
+    : entry(str.empty() ? nullptr : StringPool::instance().intern(str)) {}
+
+InternedString::InternedString(const char* str)
+    : entry(*str == '\0' ? nullptr : StringPool::instance().intern(str)) {}
+
+InternedString::InternedString(const InternedString& other) : entry(other.entry) {
+    // У копируемой строки уже есть ссылка, поэтому запись не может исчезнуть
+    if (entry) {
+        entry->second.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+InternedString::~InternedString() {
+    if (entry) {
+        StringPool::instance().release(entry);
+    }
+}
+
+const std::string& InternedString::emptyString() {
+    static const std::string empty;
+    return empty;
+}
+
+std::ostream& operator<<(std::ostream& os, const InternedString& str) {
+    return os << str.str();
+}
+
+StringPool::StringPool() {
+    stats.requests = 0;
+    stats.uniqueStrings = 0;
+    stats.uniqueBytes = 0;
+    stats.bytesSaved = 0;
+}
+
+StringPool& StringPool::instance() {
+    static StringPool pool;
+    return pool;
+}
+
+StringPool::Entry* StringPool::intern(const std::string& str) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.requests++;
+    
+    auto found = strings.find(str);
+    if (found == strings.end()) {
+        found = strings.emplace(std::piecewise_construct, std::forward_as_tuple(str),
+                                std::forward_as_tuple(0)).first;
+        stats.uniqueStrings++;
+        stats.uniqueBytes += str.length();
+    }
+    found->second.fetch_add(1, std::memory_order_relaxed);
+    
+    // Элементы unordered_map не перемещаются при перехешировании
+    return &*found;
+}
+
+void StringPool::release(Entry* entry) {
+    // Пока ссылка не последняя, хватает атомарного уменьшения
+    size_t refs = entry->second.load(std::memory_order_relaxed);
+    while (refs > 1) {
+        if (entry->second.compare_exchange_weak(refs, refs - 1)) {
+            return;
+        }
+    }
+    
+    // Последняя ссылка снимается под блокировкой, чтобы intern() не вернул
+    // запись, которая сейчас удаляется
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entry->second.fetch_sub(1) == 1) {
+        stats.uniqueStrings--;
+        stats.uniqueBytes -= entry->first.length();
+        strings.erase(strings.find(entry->first));
+    }
+}
+
+StringPoolStats StringPool::getStats() const {
+    // Строка, умещающаяся во внутренний буфер std::string, кучу не занимает,
+    // и ее повторы ничего не экономят
+    static const size_t INLINE_CAPACITY = std::string().capacity();
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    StringPoolStats current = stats;
+    current.bytesSaved = 0;
+    for (const auto& entry : strings) {
+        size_t refs = entry.second.load(std::memory_order_relaxed);
+        if (refs > 1 && entry.first.length() > INLINE_CAPACITY) {
+            current.bytesSaved += (refs - 1) * entry.first.length();
+        }
+    }
+    return current;
+}
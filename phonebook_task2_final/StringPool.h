@@ -0,0 +1,76 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <string>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+
+// Статистика пула строк
+struct StringPoolStats {
+    size_t requests;      // сколько раз строки передавались в пул
+    size_t uniqueStrings; // сколько различных строк хранится
+    size_t uniqueBytes;   // суммарный размер различных строк
+    size_t bytesSaved;    // сколько байт кучи не занимают повторы живых строк
+                          // (короткие строки хранятся в самом std::string и не считаются)
+};
+
+// Глобальный пул повторяющихся строк (имена, отчества, домены почты,
+// город и улица адреса). У каждой строки счетчик ссылок: когда последняя
+// InternedString с этим значением уничтожена, строка удаляется из пула.
+class StringPool {
+public:
+    typedef std::pair<const std::string, std::atomic<size_t>> Entry;
+
+private:
+    std::unordered_map<std::string, std::atomic<size_t>> strings;
+    StringPoolStats stats;
+    mutable std::mutex mutex;
+    
+    StringPool();
+
+public:
+    static StringPool& instance();
+    
+    // Возвращает запись пула с уже увеличенным счетчиком ссылок
+    Entry* intern(const std::string& str);
+    void release(Entry* entry);
+    StringPoolStats getStats() const;
+};
+
+// Строка из общего пула: одинаковые значения разделяют один неизменяемый
+// буфер, поэтому сравнение на равенство - это сравнение указателей.
+// Пустая строка в пул не попадает и блокировку не берет.
+class InternedString {
+private:
+    StringPool::Entry* entry;  // nullptr - пустая строка
+    
+    static const std::string& emptyString();
+
+public:
+    InternedString() : entry(nullptr) {}
+    InternedString(const std::string& str);
+    InternedString(const char* str);
+    InternedString(const InternedString& other);
+    InternedString(InternedString&& other) noexcept : entry(other.entry) { other.entry = nullptr; }
+    ~InternedString();
+    
+    InternedString& operator=(InternedString other) {
+        std::swap(entry, other.entry);
+        return *this;
+    }
+    
+    const std::string& str() const { return entry ? entry->first : emptyString(); }
+    operator const std::string&() const { return str(); }
+    bool empty() const { return entry == nullptr; }
+    size_t length() const { return str().length(); }
+    
+    bool operator==(const InternedString& other) const { return entry == other.entry; }
+    bool operator!=(const InternedString& other) const { return entry != other.entry; }
+    bool operator<(const InternedString& other) const { return str() < other.str(); }
+};
+
+std::ostream& operator<<(std::ostream& os, const InternedString& str);
+
+#endif // STRINGPOOL_H
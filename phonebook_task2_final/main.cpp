@@ -1,7 +1,14 @@
 #include "ConsoleUI.h"
+#include "BatchCLI.h"
+#include "RpcServer.h"
+#include "RpcClient.h"
+#include "Benchmark.h"
+#include "SelfTest.h"
 #include <iostream>
 #include <exception>
 #include <locale>
+#include <vector>
+#include <string>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -21,15 +28,98 @@ int main(int argc, char* argv[]) {
             std::locale::global(std::locale(""));
         #endif
         
+        // Нагрузочный тест сервера, справочник не загружается:
+        //   phonebook bench <сокет> [соединений] [запросов] [глубина] [команда]
+        if (argc > 2 && std::string(argv[1]) == "bench") {
+            size_t connections = argc > 3 ? std::stoul(argv[3]) : 4;
+            size_t requests = argc > 4 ? std::stoul(argv[4]) : 10000;
+            size_t depth = argc > 5 ? std::stoul(argv[5]) : 16;
+            std::string command = "count";
+            if (argc > 6) {
+                command = argv[6];
+                for (int i = 7; i < argc; ++i) {
+                    command += ' ';
+                    command += argv[i];
+                }
+            }
+            return runRpcBenchmark(argv[2], std::vector<std::string>(1, command), connections, requests, depth);
+        }
+        
+        // Замеры производительности, справочник не загружается:
+        //   phonebook perf sort [ключей] [потоков]
+        //   phonebook perf readers [контактов] [потоков] [секунд]
+        //   phonebook perf accessors [контактов] [проходов]
+        if (argc > 2 && std::string(argv[1]) == "perf" && std::string(argv[2]) == "sort") {
+            return runSortBenchmark(argc > 3 ? std::stoul(argv[3]) : 1000000,
+                                    argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 0);
+        }
+        if (argc > 2 && std::string(argv[1]) == "perf" && std::string(argv[2]) == "readers") {
+            return runReadBenchmark(argc > 3 ? std::stoul(argv[3]) : 20000,
+                                    argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 0,
+                                    argc > 5 ? std::stod(argv[5]) : 1.0);
+        }
+        if (argc > 2 && std::string(argv[1]) == "perf" && std::string(argv[2]) == "accessors") {
+            return runAccessorBenchmark(argc > 3 ? std::stoul(argv[3]) : 100000,
+                                        argc > 4 ? std::stoul(argv[4]) : 20);
+        }
+        
+        // Самопроверка на временных файлах: phonebook selftest
+        if (argc == 2 && std::string(argv[1]) == "selftest") {
+            return runSelfTest();
+        }
+        
         // Можно указать имя файла через аргумент командной строки
         std::string filename = "phonebook.txt";
-        if (argc > 1) {
+        int firstArg = 1;
+        if (argc > 1 && !BatchCLI::isCommand(argv[1]) && std::string(argv[1]) != "serve" &&
+            std::string(argv[1]).compare(0, 2, "--") != 0) {
             filename = argv[1];
+            firstArg = 2;
+        }
+        
+        // Удаление надгробиями для скриптов и сервера (команды обращаются
+        // к контактам по идентификаторам и ключам): --tombstones[=доля], по умолчанию 0.25
+        bool tombstones = false;
+        double compactThreshold = 0.25;
+        if (argc > firstArg && std::string(argv[firstArg]).compare(0, 12, "--tombstones") == 0) {
+            std::string option = argv[firstArg];
+            if (option.size() > 12) {
+                if (option[12] != '=') {
+                    std::cerr << "Неизвестный ключ: " << option << std::endl;
+                    return 1;
+                }
+                compactThreshold = std::stod(option.substr(13));
+            }
+            tombstones = true;
+            firstArg++;
+            if (argc == firstArg) {
+                std::cerr << "После --tombstones нужна команда" << std::endl;
+                return 1;
+            }
+        }
+        
+        // Команда после имени файла - неинтерактивный режим для скриптов:
+        //   phonebook [файл] [--tombstones[=доля]] <команда> [аргументы]
+        //   phonebook [файл] [--tombstones[=доля]] batch < команды
+        if (argc > firstArg) {
+            std::ios::sync_with_stdio(false);
+            std::vector<std::string> args(argv + firstArg, argv + argc);
+            PhoneBook phoneBook(filename);
+            if (tombstones) {
+                phoneBook.setTombstoneMode(true, compactThreshold);
+            }
+            // Сервер на локальном сокете: phonebook [файл] serve [сокет]
+            if (args[0] == "serve") {
+                RpcServer server(phoneBook, args.size() > 1 ? args[1] : filename + ".sock");
+                return server.run();
+            }
+            BatchCLI cli(phoneBook);
+            return cli.runCommand(args);
         }
         
         ConsoleUI ui(filename);
         ui.run();
-        
+    
     } catch (const std::exception& e) {
         std::cerr << "Ошибка: " << e.what() << std::endl;
         return 1;
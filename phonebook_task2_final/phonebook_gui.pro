@@ -6,11 +6,23 @@ TARGET = phonebook_gui
 SOURCES += \
     gui_main.cpp \
     QtMainWindow.cpp \
+    BookLoader.cpp \
+    Collation.cpp \
     Contact.cpp \
-    PhoneBook.cpp
+    ContactListModel.cpp \
+    PhoneBook.cpp \
+    ReadWriteLock.cpp \
+    SearchWorker.cpp \
+    StringPool.cpp
 
 HEADERS += \
     QtMainWindow.h \
+    BookLoader.h \
+    Collation.h \
     Contact.h \
-    PhoneBook.h
+    ContactListModel.h \
+    PhoneBook.h \
+    ReadWriteLock.h \
+    SearchWorker.h \
+    StringPool.h
 